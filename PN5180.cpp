@@ -28,17 +28,23 @@
 #define PN5180_WRITE_REGISTER_OR_MASK   (0x01)
 #define PN5180_WRITE_REGISTER_AND_MASK  (0x02)
 #define PN5180_READ_REGISTER            (0x04)
+#define PN5180_READ_REGISTER_MULTIPLE   (0x05)
 #define PN5180_WRITE_EEPROM             (0x06)
 #define PN5180_READ_EEPROM              (0x07)
 #define PN5180_SEND_DATA                (0x09)
 #define PN5180_READ_DATA                (0x0A)
 #define PN5180_SWITCH_MODE              (0x0B)
 #define PN5180_MIFARE_AUTHENTICATE      (0x0C)
+#define PN5180_EPC_INVENTORY            (0x0D)
+#define PN5180_EPC_RESUME_INVENTORY     (0x0E)
+#define PN5180_EPC_RETRIEVE_INVENTORY_RESULT_SIZE (0x0F)
+#define PN5180_EPC_RETRIEVE_INVENTORY_RESULT      (0x10)
 #define PN5180_LOAD_RF_CONFIG           (0x11)
 #define PN5180_RF_ON                    (0x16)
 #define PN5180_RF_OFF                   (0x17)
 
 uint8_t PN5180::readBufferStatic16[16];
+PN5180RFState PN5180::rfState = { 0xFF, 0xFF, 0xFF, -1, false, 0, 0 };
 
 PN5180::PN5180(uint8_t SSpin, uint8_t BUSYpin, uint8_t RSTpin, SPIClass& spi) :
   PN5180_NSS(SSpin),
@@ -239,6 +245,44 @@ bool PN5180::readRegister(uint8_t reg, uint32_t *value) {
   return true;
 }
 
+/*
+ * READ_REGISTER_MULTIPLE - 0x05
+ * This command is used to read up to 18 configuration registers at once. The
+ * response contains the 4 byte content of each register (little endian) in
+ * the order of the requested addresses.
+ * The addresses of the registers must exist. If the condition is not fulfilled,
+ * an exception is raised.
+ */
+bool PN5180::readRegisterMultiple(const uint8_t *regs, uint8_t numRegs, uint32_t *values) {
+  PN5180DEBUG_PRINTF(F("PN5180::readRegisterMultiple(*regs, numRegs=%d, *values)"), numRegs);
+  PN5180DEBUG_PRINTLN();
+  PN5180DEBUG_ENTER;
+
+  if ((numRegs == 0) || (numRegs > 18)) {
+    PN5180DEBUG_PRINTLN(F("ERROR: 1..18 registers can be read at once!"));
+    PN5180DEBUG_EXIT;
+    return false;
+  }
+
+  uint8_t cmd[19];
+  cmd[0] = PN5180_READ_REGISTER_MULTIPLE;
+  for (int i=0; i<numRegs; i++) {
+    cmd[1+i] = regs[i];
+  }
+  uint8_t buffer[18*4];
+  if (!transceiveCommand(cmd, numRegs+1, buffer, numRegs*4)) {
+    PN5180DEBUG_EXIT;
+    return false;
+  }
+  for (int i=0; i<numRegs; i++) {
+    values[i] = (uint32_t)buffer[4*i] | ((uint32_t)buffer[4*i+1] << 8) |
+                ((uint32_t)buffer[4*i+2] << 16) | ((uint32_t)buffer[4*i+3] << 24);
+  }
+
+  PN5180DEBUG_EXIT;
+  return true;
+}
+
 /*
  * WRITE_EEPROM - 0x06
  */
@@ -343,18 +387,29 @@ bool PN5180::sendData(const uint8_t *data, int len, uint8_t validBits) {
     buffer[2+i] = data[i];
   }
 
-  writeRegisterWithAndMask(SYSTEM_CONFIG, 0xfffffff8);  // Idle/StopCom Command
-  writeRegisterWithOrMask(SYSTEM_CONFIG, 0x00000003);   // Transceive Command
-  /*
-   * Transceive command; initiates a transceive cycle.
-   * Note: Depending on the value of the Initiator bit, a
-   * transmission is started or the receiver is enabled
-   * Note: The transceive command does not finish
-   * automatically. It stays in the transceive cycle until
-   * stopped via the IDLE/StopCom command
-   */
-
-  PN5180TransceiveStat transceiveState = getTransceiveState();
+  // still in the transceive cycle of the last command, e.g. after a reception
+  PN5180RFState *state = trackedRFState();
+  PN5180TransceiveStat transceiveState = PN5180_TS_Idle;
+  if (state->transceive) {
+    transceiveState = getTransceiveState();
+  }
+  if (PN5180_TS_WaitTransmit == transceiveState) {
+    state->skipped++;
+  }
+  else {
+    writeRegisterWithAndMask(SYSTEM_CONFIG, 0xfffffff8);  // Idle/StopCom Command
+    writeRegisterWithOrMask(SYSTEM_CONFIG, 0x00000003);   // Transceive Command
+    /*
+     * Transceive command; initiates a transceive cycle.
+     * Note: Depending on the value of the Initiator bit, a
+     * transmission is started or the receiver is enabled
+     * Note: The transceive command does not finish
+     * automatically. It stays in the transceive cycle until
+     * stopped via the IDLE/StopCom command
+     */
+    transceiveState = getTransceiveState();
+  }
+  state->transceive = (PN5180_TS_WaitTransmit == transceiveState);
   if (PN5180_TS_WaitTransmit != transceiveState) {
     PN5180DEBUG_PRINTLN(F("*** ERROR: Transceiver not in state WaitTransmit!?"));
     PN5180DEBUG_EXIT;
@@ -507,6 +562,7 @@ bool PN5180::switchToLPCD(uint16_t wakeupCounterInMs) {
   writeRegister(IRQ_ENABLE, LPCD_IRQ_STAT | GENERAL_ERROR_IRQ_STAT);  
   // switch mode to LPCD 
   uint8_t cmd[] = { PN5180_SWITCH_MODE, 0x01, (uint8_t)(wakeupCounterInMs & 0xFF), (uint8_t)((wakeupCounterInMs >> 8U) & 0xFF) };
+  invalidateRFState();  // field and configuration change in LPCD mode
   return transceiveCommand(cmd, sizeof(cmd));
 }
 
@@ -545,6 +601,105 @@ int16_t PN5180::mifareAuthenticate(uint8_t blockNo, const uint8_t *key, uint8_t
 
 }
 
+/*
+ * EPC_INVENTORY - 0x0D
+ * This command performs an ISO 18000-3 Mode 3 inventory: an optional Select
+ * command is sent, followed by the BeginRound (Query) command. The PN5180
+ * handles the timeslots (ACK, NextSlot) on its own and stores the tag
+ * replies in the inventory result buffer.
+ * selectCommand: Select without CRC-16 (0..39 bytes, NULL if not used),
+ *                selectValidBits: valid bits in its last byte (0 = all 8)
+ * beginRoundCommand: 3 bytes, Query command
+ * timeslotBehavior: 0 = process timeslots until the result buffer is full
+ *                       or the round is complete
+ *                   1 = one timeslot only
+ *                   2 = one timeslot, the handle of a valid reply is
+ *                       requested (Req_RN)
+ * Completion is signaled by the IDLE IRQ.
+ */
+bool PN5180::epcInventory(const uint8_t *selectCommand, uint8_t selectCommandLength, uint8_t selectValidBits,
+                          const uint8_t *beginRoundCommand, uint8_t timeslotBehavior) {
+  PN5180DEBUG_PRINTF(F("PN5180::epcInventory(selectLen=%d, behavior=%d)"), selectCommandLength, timeslotBehavior);
+  PN5180DEBUG_PRINTLN();
+  PN5180DEBUG_ENTER;
+
+  if (selectCommandLength > 39) {
+    PN5180DEBUG_PRINTLN(F("*** ERROR: Select command too long!"));
+    PN5180DEBUG_EXIT;
+    return false;
+  }
+  uint8_t cmd[46];
+  uint8_t len = 0;
+  cmd[len++] = PN5180_EPC_INVENTORY;
+  cmd[len++] = selectCommandLength;
+  if (selectCommandLength > 0) {
+    cmd[len++] = selectValidBits;
+    for (int i=0; i<selectCommandLength; i++) {
+      cmd[len++] = selectCommand[i];
+    }
+  }
+  for (int i=0; i<3; i++) {
+    cmd[len++] = beginRoundCommand[i];
+  }
+  cmd[len++] = timeslotBehavior;
+
+  bool ret = transceiveCommand(cmd, len);
+  PN5180DEBUG_EXIT;
+  return ret;
+}
+
+/*
+ * EPC_RESUME_INVENTORY - 0x0E
+ * Continues an inventory paused because the result buffer was full, after
+ * the results have been retrieved.
+ */
+bool PN5180::epcResumeInventory() {
+  PN5180DEBUG_PRINTLN(F("PN5180::epcResumeInventory()"));
+  PN5180DEBUG_ENTER;
+  uint8_t cmd[] = { PN5180_EPC_RESUME_INVENTORY, 0x00 };
+  bool ret = transceiveCommand(cmd, sizeof(cmd));
+  PN5180DEBUG_EXIT;
+  return ret;
+}
+
+/*
+ * EPC_RETRIEVE_INVENTORY_RESULT_SIZE - 0x0F
+ * Size in bytes of the inventory result buffer content.
+ */
+bool PN5180::epcRetrieveInventoryResultSize(uint16_t *size) {
+  PN5180DEBUG_PRINTLN(F("PN5180::epcRetrieveInventoryResultSize()"));
+  PN5180DEBUG_ENTER;
+  uint8_t cmd[] = { PN5180_EPC_RETRIEVE_INVENTORY_RESULT_SIZE, 0x00 };
+  uint8_t buffer[2];
+  bool ret = transceiveCommand(cmd, sizeof(cmd), buffer, 2);
+  if (ret) {
+    *size = (uint16_t)buffer[0] | ((uint16_t)buffer[1] << 8);
+  }
+  PN5180DEBUG_EXIT;
+  return ret;
+}
+
+/*
+ * EPC_RETRIEVE_INVENTORY_RESULT - 0x10
+ * Reads len bytes (see epcRetrieveInventoryResultSize()) of the inventory
+ * result buffer. Per timeslot:
+ *  - response length in bytes
+ *  - bits 2..0: valid bits in the last byte (0 = all 8),
+ *    bits 7..4: timeslot status (0 = tag reply, 1 = tag reply and handle,
+ *    2 = no reply, 3 = collision)
+ *  - tag reply (PC, UII, CRC-16)
+ *  - tag handle (2 bytes, status 1 only)
+ */
+bool PN5180::epcRetrieveInventoryResult(uint8_t *buffer, uint16_t len) {
+  PN5180DEBUG_PRINTF(F("PN5180::epcRetrieveInventoryResult(len=%d)"), len);
+  PN5180DEBUG_PRINTLN();
+  PN5180DEBUG_ENTER;
+  uint8_t cmd[] = { PN5180_EPC_RETRIEVE_INVENTORY_RESULT, 0x00 };
+  bool ret = transceiveCommand(cmd, sizeof(cmd), buffer, len);
+  PN5180DEBUG_EXIT;
+  return ret;
+}
+
 /*
  * LOAD_RF_CONFIG - 0x11
  * Parameter 'Transmitter Configuration' must be in the range from 0x0 - 0x1C, inclusive. If
@@ -560,8 +715,19 @@ int16_t PN5180::mifareAuthenticate(uint8_t blockNo, const uint8_t *key, uint8_t
  * configuration                       (kbit/s)  configuration               (kbit/s)
  * byte (hex)                                    byte (hex)
  * ----------------------------------------------------------------------------------------------
+ *   00              ISO 14443-A       106       80              ISO 14443-A 106
+ *   04              ISO 14443-B       106       84              ISO 14443-B 106
+ *   05              ISO 14443-B       212       85              ISO 14443-B 212
+ *   06              ISO 14443-B       424       86              ISO 14443-B 424
+ *   07              ISO 14443-B       848       87              ISO 14443-B 848
+ *   08              FeliCa            212       88              FeliCa      212
+ *   09              FeliCa            424       89              FeliCa      424
  * ->0D              ISO 15693 ASK100  26        8D              ISO 15693   26
  *   0E              ISO 15693 ASK10   26        8E              ISO 15693   53
+ *   0F              ISO 18000-3M3     Tari=18.88us  8F          Manchester 424 kHz, 4 periods
+ *   10              ISO 18000-3M3     Tari=9.44us   90          Manchester 424 kHz, 2 periods
+ *                                                 91          Manchester 848 kHz, 4 periods
+ *                                                 92          Manchester 848 kHz, 2 periods
  */
 bool PN5180::loadRFConfig(uint8_t txConf, uint8_t rxConf) {
   PN5180DEBUG(F("Load RF-Config: txConf="));
@@ -571,12 +737,28 @@ bool PN5180::loadRFConfig(uint8_t txConf, uint8_t rxConf) {
   PN5180DEBUG_PRINTLN();
   PN5180DEBUG_ENTER;
 
+  PN5180RFState *state = trackedRFState();
+  if (((0xFF == txConf) || (txConf == state->txConf)) && ((0xFF == rxConf) || (rxConf == state->rxConf))) {
+    PN5180DEBUG_PRINTLN(F("already loaded"));
+    state->skipped++;
+    PN5180DEBUG_EXIT;
+    return true;
+  }
+
   uint8_t cmd[] = { PN5180_LOAD_RF_CONFIG, txConf, rxConf };
 
-  transceiveCommand(cmd, sizeof(cmd));
+  bool ret = transceiveCommand(cmd, sizeof(cmd));
+  if (ret) {
+    if (0xFF != txConf) state->txConf = txConf;
+    if (0xFF != rxConf) state->rxConf = rxConf;
+  }
+  else {
+    state->txConf = state->rxConf = 0xFF;
+  }
+  state->transceive = false;
 
   PN5180DEBUG_EXIT;
-  return true;
+  return ret;
 }
 
 /*
@@ -588,6 +770,15 @@ bool PN5180::setRF_on() {
   PN5180DEBUG_PRINTLN(F("Set RF ON"));
   PN5180DEBUG_ENTER;
 
+  PN5180RFState *state = trackedRFState();
+  if (1 == state->field) {
+    PN5180DEBUG_PRINTLN(F("RF field is on already"));
+    state->skipped++;
+    PN5180DEBUG_EXIT;
+    return true;
+  }
+  state->field = -1;
+
   uint8_t cmd[] = { PN5180_RF_ON, 0x00 };
 
   transceiveCommand(cmd, sizeof(cmd));
@@ -608,6 +799,8 @@ bool PN5180::setRF_on() {
   PN5180DEBUG_ON;
   
   clearIRQStatus(TX_RFON_IRQ_STAT);
+  state->field = 1;
+  state->session++;             // cards in the field start unpowered
   PN5180DEBUG_EXIT;
   return true;
 }
@@ -621,6 +814,15 @@ bool PN5180::setRF_off() {
   PN5180DEBUG_PRINTLN(F("Set RF OFF"));
   PN5180DEBUG_ENTER;
 
+  PN5180RFState *state = trackedRFState();
+  if (0 == state->field) {
+    PN5180DEBUG_PRINTLN(F("RF field is off already"));
+    state->skipped++;
+    PN5180DEBUG_EXIT;
+    return true;
+  }
+  state->field = -1;
+
   uint8_t cmd[] { PN5180_RF_OFF, 0x00 };
 
   transceiveCommand(cmd, sizeof(cmd));
@@ -640,6 +842,8 @@ bool PN5180::setRF_off() {
   PN5180DEBUG_ON;  
   
   clearIRQStatus(TX_RFOFF_IRQ_STAT);
+  state->field = 0;
+  state->transceive = false;
   PN5180DEBUG_EXIT;
   return true;
 }
@@ -681,6 +885,10 @@ status register contain information on the exception.
  * 4. Deassert NSS
  * 5. Wait until BUSY is low
  * If there is a parameter error, the IRQ is set to ACTIVE and a GENERAL_ERROR_IRQ is set.
+ * BUSY changes within microseconds for most commands, so the BUSY line is
+ * polled without sleeping during the first millisecond. A single command
+ * takes well below 1ms this way, which allows short RF exchanges like a
+ * presence check to complete in about 1ms.
  */
 bool PN5180::transceiveCommand(uint8_t *sendBuffer, size_t sendBufferLen, uint8_t *recvBuffer, size_t recvBufferLen) {
   PN5180DEBUG_PRINTF(F("PN5180::transceiveCommand(*sendBuffer, sendBufferLen=%d, *recvBuffer, recvBufferLen=%d)"), sendBufferLen, recvBufferLen);
@@ -699,7 +907,7 @@ bool PN5180::transceiveCommand(uint8_t *sendBuffer, size_t sendBufferLen, uint8_
   // 0.
   unsigned long startedWaiting = millis();
   while (LOW != digitalRead(PN5180_BUSY)) {
-	  delay(1);
+	  if (millis() != startedWaiting) delay(1); // spin the first ms, then yield
 	  if (millis() - startedWaiting > commandTimeout) {
 		  PN5180DEBUG("*** ERROR: transceiveCommand timeout (send/0)");
 		  PN5180_SPI.endTransaction();
@@ -709,13 +917,13 @@ bool PN5180::transceiveCommand(uint8_t *sendBuffer, size_t sendBufferLen, uint8_
 	  };
   }; // wait until busy is low
   // 1.
-  digitalWrite(PN5180_NSS, LOW); delay(1);
+  digitalWrite(PN5180_NSS, LOW);
   // 2.
   PN5180_SPI.transfer((uint8_t*)sendBuffer, sendBufferLen);  
   // 3.
   startedWaiting = millis();
   while (HIGH != digitalRead(PN5180_BUSY)) {
-	  delay(1);
+	  if (millis() != startedWaiting) delay(1); // spin the first ms, then yield
 	  if (millis() - startedWaiting > commandTimeout) {
 		  PN5180DEBUG("*** ERROR: transceiveCommand timeout (send/3)");
 		  PN5180_SPI.endTransaction();
@@ -725,11 +933,11 @@ bool PN5180::transceiveCommand(uint8_t *sendBuffer, size_t sendBufferLen, uint8_
 	  };
   }; // wait until busy is high
   // 4.
-  digitalWrite(PN5180_NSS, HIGH); delay(1);
+  digitalWrite(PN5180_NSS, HIGH);
   // 5.
   startedWaiting = millis();
   while (LOW != digitalRead(PN5180_BUSY)) {
-	  delay(1);
+	  if (millis() != startedWaiting) delay(1); // spin the first ms, then yield
 	  if (millis() - startedWaiting > commandTimeout) {
 		  PN5180DEBUG("*** ERROR: transceiveCommand timeout (send/5)");
 		  PN5180_SPI.endTransaction();
@@ -754,9 +962,9 @@ bool PN5180::transceiveCommand(uint8_t *sendBuffer, size_t sendBufferLen, uint8_
   memset(recvBuffer, 0xFF, recvBufferLen);
   PN5180_SPI.transfer(recvBuffer, recvBufferLen);
   // 3.
-  startedWaiting = millis(); //delay(1);
+  startedWaiting = millis();
   while (HIGH != digitalRead(PN5180_BUSY)) {
-	  delay(1);
+	  if (millis() != startedWaiting) delay(1); // spin the first ms, then yield
 	  if (millis() - startedWaiting > commandTimeout) {
 		  PN5180DEBUG("*** ERROR: transceiveCommand timeout (receive/3)");
 		  PN5180_SPI.endTransaction();
@@ -770,7 +978,7 @@ bool PN5180::transceiveCommand(uint8_t *sendBuffer, size_t sendBufferLen, uint8_
   // 5.
   startedWaiting = millis();
   while (LOW != digitalRead(PN5180_BUSY)) {
-	  delay(1);
+	  if (millis() != startedWaiting) delay(1); // spin the first ms, then yield
 	  if (millis() - startedWaiting > commandTimeout) {
 		  PN5180DEBUG("*** ERROR: transceiveCommand timeout (receive/5)");
 		  PN5180_SPI.endTransaction();
@@ -799,6 +1007,7 @@ bool PN5180::transceiveCommand(uint8_t *sendBuffer, size_t sendBufferLen, uint8_
 void PN5180::reset() {
   PN5180DEBUG_PRINTLN(F("PN5180::reset()"));
   PN5180DEBUG_ENTER;
+  invalidateRFState();
   digitalWrite(PN5180_RST, LOW);  // at least 10us required
   delay(1);
   digitalWrite(PN5180_RST, HIGH); // 2ms to ramp up required
@@ -858,6 +1067,75 @@ bool PN5180::clearIRQStatus(uint32_t irqMask) {
   return ret;
 }
 
+/*
+ * Poll the IRQ_STATUS register until at least one of the bits in irqMask
+ * is set or timeoutUs microseconds have passed. Used to pace RF exchanges
+ * on the reception IRQ instead of fixed delays.
+ * The last IRQ status read is returned in irqStatus (if not NULL).
+ */
+bool PN5180::waitForIRQ(uint32_t irqMask, uint32_t timeoutUs, uint32_t *irqStatus) {
+  PN5180DEBUG_PRINTF(F("PN5180::waitForIRQ(mask=%s, timeoutUs=%lu)"), formatHex(irqMask), timeoutUs);
+  PN5180DEBUG_PRINTLN();
+  PN5180DEBUG_ENTER;
+
+  uint32_t status;
+  unsigned long startedWaiting = micros();
+  PN5180DEBUG_OFF;
+  while (0 == ((status = getIRQStatus()) & irqMask)) {
+    if (micros() - startedWaiting > timeoutUs) {
+      PN5180DEBUG_ON;
+      PN5180DEBUG_PRINTLN(F("*** ERROR: waitForIRQ timeout"));
+      if (irqStatus) *irqStatus = status;
+      PN5180DEBUG_EXIT;
+      return false;
+    }
+  }
+  PN5180DEBUG_ON;
+
+  if (irqStatus) *irqStatus = status;
+  PN5180DEBUG_EXIT;
+  return true;
+}
+
+/*
+ * RF state tracking: loadRFConfig(), setRF_on(), setRF_off() and the
+ * transceive setup of sendData() are skipped if they would not change
+ * anything. The state is shared by all instances and belongs to the reader
+ * with the NSS pin of the last caller, a different reader starts unknown.
+ * The RF session changes with each field ramp-up and invalidateRFState();
+ * cards selected in an older session are back in their power-on state.
+ */
+PN5180RFState *PN5180::trackedRFState() {
+  if (rfState.nss != PN5180_NSS) {
+    invalidateRFState();
+    rfState.nss = PN5180_NSS;
+  }
+  return &rfState;
+}
+
+/*
+ * Forget the tracked RF state, the next loadRFConfig(), setRF_on() etc.
+ * are executed in any case. Call this to recover from errors, or after
+ * changing the RF configuration with direct register or EEPROM writes.
+ * Called by reset() and switchToLPCD(). Starts a new RF session, so the
+ * protocol classes sharing the PN5180 drop their selected cards.
+ */
+void PN5180::invalidateRFState() {
+  rfState.txConf = 0xFF;
+  rfState.rxConf = 0xFF;
+  rfState.field = -1;
+  rfState.transceive = false;
+  rfState.session++;
+}
+
+/*
+ * True if the RF field was switched on by setRF_on() and not switched off
+ * since, false if it is off or unknown.
+ */
+bool PN5180::isRFOn() {
+  return (1 == trackedRFState()->field);
+}
+
 /*
  * Get TRANSCEIVE_STATE from RF_STATUS register
  */
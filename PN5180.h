@@ -84,6 +84,17 @@ enum PN5180TransceiveStat {
 #define MIFARE_CLASSIC_KEYA 0x60  // Mifare Classic key A
 #define MIFARE_CLASSIC_KEYB 0x61  // Mifare Classic key B
 
+// RF state as last set through this library, see invalidateRFState()
+struct PN5180RFState {
+  uint8_t nss;                  // reader the state belongs to
+  uint8_t txConf;               // loaded RF configuration, 0xFF: unknown
+  uint8_t rxConf;
+  int8_t field;                 // -1: unknown, 0: off, 1: on
+  bool transceive;              // SYSTEM_CONFIG.COMMAND set to Transceive
+  uint16_t session;             // incremented whenever cards may have lost power
+  uint32_t skipped;             // redundant reconfigurations skipped
+};
+
 class PN5180 {
 private:
   uint8_t PN5180_NSS;   // active low
@@ -96,6 +107,9 @@ private:
 
   SPISettings SPI_SETTINGS;
   static uint8_t readBufferStatic16[16];
+  // shared by all instances, the protocol classes often drive one PN5180
+  static PN5180RFState rfState;
+  PN5180RFState *trackedRFState();
   uint8_t* readBufferDynamic508 = NULL;
 public:
   PN5180(uint8_t SSpin, uint8_t BUSYpin, uint8_t RSTpin, SPIClass& spi=SPI);
@@ -118,6 +132,8 @@ public:
 
   /* cmd 0x04 */
   bool readRegister(uint8_t reg, uint32_t *value);
+  /* cmd 0x05 */
+  bool readRegisterMultiple(const uint8_t *regs, uint8_t numRegs, uint32_t *values);
 
   /* cmd 0x06 */
   bool writeEEprom(uint8_t addr, const uint8_t *buffer, uint8_t len);
@@ -135,6 +151,15 @@ public:
   bool switchToLPCD(uint16_t wakeupCounterInMs);
   /* cmd 0x0C */
   int16_t mifareAuthenticate(uint8_t blockno, const uint8_t *key, uint8_t keyType, const uint8_t *uid);
+  /* cmd 0x0D */
+  bool epcInventory(const uint8_t *selectCommand, uint8_t selectCommandLength, uint8_t selectValidBits,
+                    const uint8_t *beginRoundCommand, uint8_t timeslotBehavior);
+  /* cmd 0x0E */
+  bool epcResumeInventory();
+  /* cmd 0x0F */
+  bool epcRetrieveInventoryResultSize(uint16_t *size);
+  /* cmd 0x10 */
+  bool epcRetrieveInventoryResult(uint8_t *buffer, uint16_t len);
   /* cmd 0x11 */
   bool loadRFConfig(uint8_t txConf, uint8_t rxConf);
 
@@ -154,8 +179,13 @@ public:
   uint16_t commandTimeout = 500;
   uint32_t getIRQStatus();
   bool clearIRQStatus(uint32_t irqMask);
+  bool waitForIRQ(uint32_t irqMask, uint32_t timeoutUs, uint32_t *irqStatus = NULL);
 
   PN5180TransceiveStat getTransceiveState();
+  void invalidateRFState();
+  bool isRFOn();
+  uint16_t getRFSession() { return trackedRFState()->session; }   // see trackedRFState()
+  uint32_t getSkippedReconfigurations() { return rfState.skipped; }
 
   /*
    * Private methods, called within an SPI transaction
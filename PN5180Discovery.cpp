@@ -0,0 +1,215 @@
+// NAME: PN5180Discovery.cpp
+//
+// DESC: Polling loop over several RF technologies with one NXP Semiconductors
+//       PN5180 module for Arduino.
+//
+// This file is part of the PN5180 library for the Arduino environment.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+//#define DEBUG 1
+
+#include <Arduino.h>
+#include "PN5180Discovery.h"
+#include "Debug.h"
+
+PN5180Discovery::PN5180Discovery(uint8_t SSpin, uint8_t BUSYpin, uint8_t RSTpin, SPIClass& spi)
+              : iso14443(SSpin, BUSYpin, RSTpin, spi),
+                iso14443b(SSpin, BUSYpin, RSTpin, spi),
+                felica(SSpin, BUSYpin, RSTpin, spi),
+                iso15693(SSpin, BUSYpin, RSTpin, spi) {
+  for (uint8_t i=0; i<PN5180_NUM_TECH; i++) {
+    order[i] = (PN5180Technology)i;
+  }
+  numTech = PN5180_NUM_TECH;
+  memset(&stats, 0, sizeof(stats));
+}
+
+void PN5180Discovery::begin(int8_t sck, int8_t miso, int8_t mosi, int8_t SSpin) {
+  iso14443.begin(sck, miso, mosi, SSpin);
+  iso14443b.begin(sck, miso, mosi, SSpin);
+  felica.begin(sck, miso, mosi, SSpin);
+  iso15693.begin(sck, miso, mosi, SSpin);
+}
+
+void PN5180Discovery::reset() {
+  iso14443.reset();
+  active = PN5180_TECH_NONE;
+}
+
+/*
+ * Switch on the RF field, the only setupRF() of a discovery loop (except
+ * for field resets, see setFieldReset()). Technologies are switched by
+ * loading their RF configuration only.
+ */
+bool PN5180Discovery::setupRF() {
+  bool ok = iso14443.setupRF();
+  active = ok ? PN5180_TECH_ISO14443A : PN5180_TECH_NONE;
+  return ok;
+}
+
+/*
+ * Technologies polled by discover(), in this order. Unknown and repeated
+ * entries are ignored.
+ */
+void PN5180Discovery::setTechnologies(const PN5180Technology *order, uint8_t numTech) {
+  this->numTech = 0;
+  for (uint8_t i=0; (i<numTech) && (this->numTech < PN5180_NUM_TECH); i++) {
+    if (order[i] >= PN5180_NUM_TECH) continue;
+    bool known = false;
+    for (uint8_t j=0; j<this->numTech; j++) {
+      if (this->order[j] == order[i]) known = true;
+    }
+    if (!known) this->order[this->numTech++] = order[i];
+  }
+}
+
+/*
+ * Load the RF configuration of tech, the field stays on. Nothing is done
+ * if tech is already active.
+ */
+bool PN5180Discovery::switchTo(PN5180Technology tech) {
+  if (!iso14443.isRFOn() && !setupRF()) {
+    return false;
+  }
+  if (tech == active) {
+    return true;
+  }
+  PN5180DEBUG(F("Switch to "));
+  PN5180DEBUG(techName(tech));
+  PN5180DEBUG_PRINTLN();
+
+  bool ok = false;
+  switch (tech) {
+    case PN5180_TECH_ISO14443A: ok = iso14443.configureRF(); break;
+    case PN5180_TECH_ISO14443B: ok = iso14443b.configureRF(); break;
+    case PN5180_TECH_FELICA: ok = felica.configureRF(); break;
+    case PN5180_TECH_ISO15693: ok = iso15693.configureRF(); break;
+    default: break;
+  }
+  active = ok ? tech : PN5180_TECH_NONE;
+  if (ok) stats.switches++;
+  return ok;
+}
+
+/*
+ * One detection with the short timeouts of the technology:
+ * - Type A: keep-alive READ of a card selected before, else WUPA and
+ *   anticollision with activateTypeA(), the card stays ACTIVE
+ * - Type B: WUPB with 1 slot, the card stays in READY-DECLARED state
+ * - FeliCa: SENSF_REQ with 1 slot
+ * - ISO15693: INVENTORY with 1 slot
+ */
+bool PN5180Discovery::poll(PN5180Technology tech, PN5180DiscoveryResult *result) {
+  result->idLength = 0;
+  switch (tech) {
+    case PN5180_TECH_ISO14443A: {
+      // the card selected by the last cycle ignores WUPA, the keep-alive
+      // READ of isCardPresentFast() keeps it ACTIVE
+      if (iso14443.isCardSelected() && iso14443.isCardPresentFast() && iso14443.isCardSelected()) {
+        result->idLength = iso14443.getSelectedUid(result->id);
+        return true;
+      }
+      uint8_t buffer[10];
+      int8_t uidLength = iso14443.activateTypeA(buffer, 1);
+      if ((uidLength != 4) && (uidLength != 7)) return false;
+      memcpy(result->id, &buffer[3], uidLength);
+      result->idLength = uidLength;
+      return true;
+    }
+    case PN5180_TECH_ISO14443B: {
+      ISO14443BCard card;
+      uint8_t numCards = 0;
+      iso14443b.requestB(&card, 1, &numCards, 1, true);
+      if (0 == numCards) return false;
+      memcpy(result->id, card.pupi, 4);
+      result->idLength = 4;
+      return true;
+    }
+    case PN5180_TECH_FELICA: {
+      FeliCaCard card;
+      uint8_t numCards = 0;
+      felica.poll(&card, 1, &numCards, FELICA_SYSTEM_CODE_ANY, 1);
+      if (0 == numCards) return false;
+      memcpy(result->id, card.idm, 8);
+      result->idLength = 8;
+      return true;
+    }
+    case PN5180_TECH_ISO15693: {
+      if (ISO15693_EC_OK != iso15693.getInventory(result->id)) return false;
+      result->idLength = 8;
+      return true;
+    }
+    default:
+      return false;
+  }
+}
+
+/*
+ * One discovery cycle: the technologies set by setTechnologies() (all by
+ * default) are polled in order, the cycle ends with the first card found.
+ * The RF configuration of the technology found stays loaded, so the card
+ * can be accessed right away with getISO14443() etc.:
+ * - Type A: UID in result->id, the card is selected (ACTIVE)
+ * - Type B: attrib() with the PUPI in result->id
+ * - FeliCa: IDm in result->id, the bit rate is set already
+ * - ISO15693: UID in result->id
+ * Returns PN5180_TECH_NONE if no card was found.
+ */
+PN5180Technology PN5180Discovery::discover(PN5180DiscoveryResult *result) {
+  PN5180DEBUG_PRINTLN(F("PN5180Discovery::discover()"));
+  PN5180DEBUG_ENTER;
+  unsigned long cycleStart = micros();
+  for (uint8_t i=0; i<PN5180_NUM_TECH; i++) {
+    stats.techUs[i] = 0;
+  }
+  stats.switches = 0;
+  stats.cycles++;
+  result->tech = PN5180_TECH_NONE;
+  result->idLength = 0;
+
+  if (fieldReset && iso14443.isRFOn()) {
+    // cards left in an ACTIVE or HALT state from the last cycle are reset
+    iso14443.setRF_off();
+    delay(PN5180_FIELD_OFF_MS);
+  }
+  if (!iso14443.isRFOn() && !setupRF()) {
+    PN5180DEBUG_EXIT;
+    return PN5180_TECH_NONE;
+  }
+
+  for (uint8_t i=0; i<numTech; i++) {
+    PN5180Technology tech = order[i];
+    unsigned long start = micros();
+    bool found = switchTo(tech) && poll(tech, result);
+    stats.techUs[tech] = micros() - start;
+    if (found) {
+      result->tech = tech;
+      break;
+    }
+  }
+
+  stats.cycleUs = micros() - cycleStart;
+  PN5180DEBUG_PRINTF("*** %s, cycle %lu us", techName(result->tech), stats.cycleUs);
+  PN5180DEBUG_PRINTLN();
+  PN5180DEBUG_EXIT;
+  return result->tech;
+}
+
+const char *PN5180Discovery::techName(PN5180Technology tech) {
+  switch (tech) {
+    case PN5180_TECH_ISO14443A: return ("ISO14443A");
+    case PN5180_TECH_ISO14443B: return ("ISO14443B");
+    case PN5180_TECH_FELICA: return ("FeliCa");
+    case PN5180_TECH_ISO15693: return ("ISO15693");
+    default: return ("none");
+  }
+}
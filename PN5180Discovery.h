@@ -0,0 +1,92 @@
+// NAME: PN5180Discovery.h
+//
+// DESC: Polling loop over several RF technologies with one NXP Semiconductors
+//       PN5180 module for Arduino.
+//
+// This file is part of the PN5180 library for the Arduino environment.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+#ifndef PN5180DISCOVERY_H
+#define PN5180DISCOVERY_H
+
+#include "PN5180.h"
+#include "PN5180ISO14443.h"
+#include "PN5180ISO14443B.h"
+#include "PN5180FeliCa.h"
+#include "PN5180ISO15693.h"
+
+enum PN5180Technology {
+  PN5180_TECH_ISO14443A = 0,
+  PN5180_TECH_ISO14443B = 1,
+  PN5180_TECH_FELICA = 2,
+  PN5180_TECH_ISO15693 = 3,
+  PN5180_TECH_NONE = 0xFF
+};
+
+#define PN5180_NUM_TECH 4
+
+// field off time of a field reset, see setFieldReset()
+#ifndef PN5180_FIELD_OFF_MS
+#define PN5180_FIELD_OFF_MS 6
+#endif
+
+// Card found by discover()
+struct PN5180DiscoveryResult {
+  PN5180Technology tech;
+  uint8_t id[8];                     // UID (A), PUPI (B), IDm (FeliCa), UID (ISO15693)
+  uint8_t idLength;
+};
+
+// Timings of the last discover() cycle
+struct PN5180DiscoveryStats {
+  unsigned long techUs[PN5180_NUM_TECH];   // switch and poll, 0 if not polled
+  unsigned long cycleUs;
+  uint8_t switches;                  // RF configuration changes
+  uint32_t cycles;
+};
+
+class PN5180Discovery {
+
+public:
+  PN5180Discovery(uint8_t SSpin, uint8_t BUSYpin, uint8_t RSTpin, SPIClass& spi=SPI);
+
+private:
+  PN5180ISO14443 iso14443;
+  PN5180ISO14443B iso14443b;
+  PN5180FeliCa felica;
+  PN5180ISO15693 iso15693;
+  PN5180Technology order[PN5180_NUM_TECH];
+  uint8_t numTech = 0;
+  PN5180Technology active = PN5180_TECH_NONE;   // RF configuration loaded
+  bool fieldReset = false;
+  PN5180DiscoveryStats stats;
+  bool poll(PN5180Technology tech, PN5180DiscoveryResult *result);
+
+public:
+  void begin(int8_t sck=-1, int8_t miso=-1, int8_t mosi=-1, int8_t SSpin=-1);
+  void reset();
+  bool setupRF();
+  void setTechnologies(const PN5180Technology *order, uint8_t numTech);
+  void setFieldReset(bool fieldReset) { this->fieldReset = fieldReset; }
+  bool switchTo(PN5180Technology tech);
+  PN5180Technology discover(PN5180DiscoveryResult *result);
+  PN5180Technology getTechnology() { return active; }
+  const PN5180DiscoveryStats *getStats() { return &stats; }
+  static const char *techName(PN5180Technology tech);
+  // protocol layers, valid for the technology selected by discover() or switchTo()
+  PN5180ISO14443 &getISO14443() { return iso14443; }
+  PN5180ISO14443B &getISO14443B() { return iso14443b; }
+  PN5180FeliCa &getFeliCa() { return felica; }
+  PN5180ISO15693 &getISO15693() { return iso15693; }
+};
+
+#endif /* PN5180DISCOVERY_H */
@@ -0,0 +1,394 @@
+// NAME: PN5180FeliCa.cpp
+//
+// DESC: FeliCa protocol on NXP Semiconductors PN5180 module for Arduino.
+//
+// This file is part of the PN5180 library for the Arduino environment.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+//#define DEBUG 1
+
+#include <Arduino.h>
+#include "PN5180FeliCa.h"
+#include "Debug.h"
+
+// FeliCa commands, the response code is the command code + 1
+#define FELICA_CMD_SENSF_REQ      (0x00)
+#define FELICA_CMD_READ_WO_ENC    (0x06)
+#define FELICA_RC_SYSTEM_CODE     (0x01)
+
+// SENSF_RES with system code: LEN, 0x01, IDm (8), PMm (8), system code (2)
+#define FELICA_SENSF_RES_LEN      (20)
+// Read Without Encryption response: LEN, 0x07, IDm (8), SF1, SF2, n, data
+#define FELICA_READ_RES_LEN(n)    (13 + FELICA_BLOCK_SIZE * (n))
+
+// SENSF_RES timeslots: the first slot starts 512*64/fc after the request,
+// each slot takes 256*64/fc
+#define FELICA_SLOT0_US           (2417UL)
+#define FELICA_SLOT_US            (1208UL)
+// unit of the maximum response times in PMm, 256*16/fc
+#define FELICA_T0_US              (302UL)
+// preamble, sync code and CRC plus ~38us per byte at 212 kbit/s
+#define FELICA_FRAME_US(len)      (400UL + 40UL * (len))
+#define FELICA_MARGIN_US          (1000UL)
+// RX_STATUS: data integrity (CRC), protocol error, collision
+#define FELICA_RX_ERROR_MASK      (0x00070000UL)
+// TRANSCEIVE_CONTROL: receiver re-enabled after each reception (RxMultiple)
+#define FELICA_RX_MULTIPLE_ENABLE (0x00000002UL)
+// RxMultiple: upto 8 frames in 32 byte sub buffers of the reception buffer,
+// with length (bits 4..0) and error flags (bits 4..0) in bytes 28 and 29
+#define FELICA_RXM_FRAMES         (8)
+#define FELICA_RXM_SUB_BUFFER     (32)
+#define FELICA_RXM_LEN            (28)
+#define FELICA_RXM_STATUS         (29)
+#define FELICA_RXM_ERROR_MASK     (0x1F)
+
+PN5180FeliCa::PN5180FeliCa(uint8_t SSpin, uint8_t BUSYpin, uint8_t RSTpin, SPIClass& spi)
+              : PN5180(SSpin, BUSYpin, RSTpin, spi) {
+}
+
+/*
+ * Send a frame (starting with its LEN byte, the PN5180 adds preamble, sync
+ * code and CRC) and wait for the response, paced by RX_SOF_DET_IRQ and
+ * RX_IRQ. The response is copied including its LEN byte.
+ */
+FeliCaErrorCode PN5180FeliCa::transceive(const uint8_t *cmd, uint8_t cmdLen, uint8_t *resp, uint16_t maxLen, uint16_t *len,
+                                         uint32_t sofTimeoutUs) {
+  *len = 0;
+  clearIRQStatus(RX_IRQ_STAT | RX_SOF_DET_IRQ_STAT | TX_IRQ_STAT | IDLE_IRQ_STAT | GENERAL_ERROR_IRQ_STAT);
+  if (!sendData(cmd, cmdLen, 0x00)) {
+    return FELICA_EC_COMMAND_FAILED;
+  }
+  if (!waitForIRQ(RX_SOF_DET_IRQ_STAT | RX_IRQ_STAT, sofTimeoutUs)) {
+    return FELICA_EC_NO_CARD;
+  }
+  if (!waitForIRQ(RX_IRQ_STAT, FELICA_FRAME_US(maxLen))) {
+    return FELICA_EC_TIMEOUT;
+  }
+
+  uint32_t rxStatus;
+  if (!readRegister(RX_STATUS, &rxStatus)) {
+    return FELICA_EC_COMMAND_FAILED;
+  }
+  uint16_t rxLen = (uint16_t)(rxStatus & 0x000001ff);
+  if ((rxStatus & FELICA_RX_ERROR_MASK) || (rxLen < 2) || (rxLen > maxLen)) {
+    PN5180DEBUG_PRINTF("*** FeliCa reception error, RX_STATUS=0x%lX", rxStatus);
+    PN5180DEBUG_PRINTLN();
+    return FELICA_EC_PROTOCOL;
+  }
+  if (!readData(rxLen, resp)) {
+    return FELICA_EC_COMMAND_FAILED;
+  }
+  if ((resp[0] != rxLen) || (resp[1] != cmd[1] + 1)) {
+    return FELICA_EC_PROTOCOL;
+  }
+  *len = rxLen;
+  return FELICA_EC_OK;
+}
+
+/*
+ * Send a frame and receive with RxMultiple until windowUs has passed or
+ * the reception buffer is full. frames receives numFrames sub buffers of
+ * FELICA_RXM_SUB_BUFFER bytes each.
+ */
+FeliCaErrorCode PN5180FeliCa::transceiveMultiple(const uint8_t *cmd, uint8_t cmdLen, uint8_t *frames, uint8_t *numFrames,
+                                                 uint32_t windowUs) {
+  *numFrames = 0;
+  clearIRQStatus(RX_IRQ_STAT | RX_SOF_DET_IRQ_STAT | TX_IRQ_STAT | IDLE_IRQ_STAT | GENERAL_ERROR_IRQ_STAT);
+  if (!writeRegisterWithOrMask(TRANSCEIVE_CONTROL, FELICA_RX_MULTIPLE_ENABLE)) {
+    return FELICA_EC_COMMAND_FAILED;
+  }
+  bool ok = sendData(cmd, cmdLen, 0x00);
+  uint32_t rxStatus = 0;
+  if (ok) {
+    // all timeslots, after 8 frames the PN5180 stops receiving by itself
+    unsigned long start = micros();
+    while ((micros() - start) < windowUs) { }
+    ok = readRegister(RX_STATUS, &rxStatus);
+  }
+  uint32_t irqStatus = getIRQStatus();
+  // leave the RxMultiple cycle: Idle, single reception again
+  writeRegisterWithAndMask(SYSTEM_CONFIG, 0xFFFFFFF8);
+  writeRegisterWithAndMask(TRANSCEIVE_CONTROL, 0xFFFFFFFD);
+  if (!ok) {
+    return FELICA_EC_COMMAND_FAILED;
+  }
+  if (0 == (irqStatus & RX_IRQ_STAT)) {
+    return FELICA_EC_NO_CARD;
+  }
+
+  uint8_t n = (uint8_t)((rxStatus >> 9) & 0x0F);   // RX_NUM_FRAMES_RECEIVED
+  if (n > FELICA_RXM_FRAMES) n = FELICA_RXM_FRAMES;
+  if ((n > 0) && !readData(n * FELICA_RXM_SUB_BUFFER, frames)) {
+    return FELICA_EC_COMMAND_FAILED;
+  }
+  *numFrames = n;
+  return FELICA_EC_OK;
+}
+
+/*
+ * SENSF_REQ, code=00
+ *
+ * Request format: LEN, 0x00, System code (2), Request code, TSN
+ * Response format: LEN, 0x01, IDm (8), PMm (8), System code (2)
+ *
+ * Each card answers in a timeslot chosen at random from 0..TSN. All
+ * timeslots of one request are received with RxMultiple, upto
+ * FELICA_RXM_FRAMES responses. The request is repeated only if a slot
+ * had a collision or the reception buffer was full; the cards involved
+ * choose a new slot then. With a single slot a collision cannot be
+ * resolved, so it is not repeated.
+ */
+FeliCaErrorCode PN5180FeliCa::pollRate(FeliCaCard *cards, uint8_t maxCards, uint8_t *numCards, uint16_t systemCode, uint8_t tsn) {
+  uint8_t cmd[6] = { sizeof(cmd), FELICA_CMD_SENSF_REQ, (uint8_t)(systemCode >> 8), (uint8_t)systemCode,
+                     FELICA_RC_SYSTEM_CODE, tsn };
+  uint32_t windowUs = FELICA_FRAME_US(sizeof(cmd)) + FELICA_SLOT0_US + (tsn + 1) * FELICA_SLOT_US + FELICA_MARGIN_US;
+  uint8_t frames[FELICA_RXM_FRAMES * FELICA_RXM_SUB_BUFFER];
+  uint8_t numFrames;
+  bool repeat = true;
+  bool answered = false;
+
+  while (repeat && (*numCards < maxCards) && (stats.requests < FELICA_MAX_POLLS)) {
+    repeat = false;
+    FeliCaErrorCode rc = transceiveMultiple(cmd, sizeof(cmd), frames, &numFrames, windowUs);
+    stats.requests++;
+    if (FELICA_EC_COMMAND_FAILED == rc) {
+      return rc;
+    }
+    if (FELICA_EC_NO_CARD == rc) {
+      break;
+    }
+    answered = true;
+    if (FELICA_RXM_FRAMES == numFrames) {
+      repeat = true;             // more responses than sub buffers
+    }
+
+    for (uint8_t f=0; f<numFrames; f++) {
+      const uint8_t *resp = &frames[f * FELICA_RXM_SUB_BUFFER];
+      uint8_t len = resp[FELICA_RXM_LEN] & 0x1F;
+      if ((resp[FELICA_RXM_STATUS] & FELICA_RXM_ERROR_MASK) || (len < FELICA_SENSF_RES_LEN) ||
+          (resp[0] != len) || (resp[1] != FELICA_CMD_SENSF_REQ + 1)) {
+        PN5180DEBUG_PRINTF("*** FeliCa slot error, status=0x%02X", resp[FELICA_RXM_STATUS]);
+        PN5180DEBUG_PRINTLN();
+        stats.errors++;          // two cards in one slot
+        if (tsn > 0) repeat = true;
+        continue;
+      }
+
+      bool known = false;
+      for (uint8_t i=0; i<*numCards; i++) {
+        if (0 == memcmp(cards[i].idm, &resp[2], 8)) known = true;
+      }
+      if (known || (*numCards >= maxCards)) {
+        continue;
+      }
+      FeliCaCard *card = &cards[(*numCards)++];
+      memcpy(card->idm, &resp[2], 8);
+      memcpy(card->pmm, &resp[10], 8);
+      card->systemCode = ((uint16_t)resp[18] << 8) | resp[19];
+      card->bitRate = bitRate;
+    }
+  }
+  return answered ? FELICA_EC_OK : FELICA_EC_NO_CARD;
+}
+
+/*
+ * Discover the cards in the field.
+ * systemCode: FELICA_SYSTEM_CODE_ANY or a system code, 0xFF bytes are wildcards
+ * slots: 1, 2, 4, 8 or 16 timeslots per SENSF_REQ, upto 8 responses are
+ *        received per request
+ * Polls at the bit rate passed to setupRF(), 424 kbit/s by default, and
+ * falls back to 212 kbit/s if no card answered. The RF configuration
+ * stays at the bit rate of the cards found.
+ */
+FeliCaErrorCode PN5180FeliCa::poll(FeliCaCard *cards, uint8_t maxCards, uint8_t *numCards, uint16_t systemCode, uint8_t slots) {
+  PN5180DEBUG_PRINTF("PN5180FeliCa::poll(maxCards=%d, slots=%d)", maxCards, slots);
+  PN5180DEBUG_PRINTLN();
+  PN5180DEBUG_ENTER;
+  unsigned long startTime = micros();
+  FeliCaPollStats s = { 0, 0, 0, 0 };
+  stats = s;
+  *numCards = 0;
+
+  uint8_t tsn = 0;
+  while ((tsn < 15) && (tsn + 1 < slots)) tsn = (tsn << 1) | 0x01;
+  stats.slots = tsn + 1;
+
+  FeliCaErrorCode rc = FELICA_EC_COMMAND_FAILED;
+  if (setBitRate(preferredBitRate)) {
+    rc = pollRate(cards, maxCards, numCards, systemCode, tsn);
+  }
+  if ((FELICA_EC_NO_CARD == rc) && (FELICA_BR_212 != bitRate)) {
+    PN5180DEBUG(F("No card at 424 kbit/s, trying 212 kbit/s\n"));
+    rc = setBitRate(FELICA_BR_212) ? pollRate(cards, maxCards, numCards, systemCode, tsn) : FELICA_EC_COMMAND_FAILED;
+  }
+  if ((FELICA_EC_OK == rc) && (0 == *numCards)) {
+    rc = FELICA_EC_PROTOCOL;     // answers, but none readable
+  }
+
+  stats.timeUs = micros() - startTime;
+  PN5180DEBUG_PRINTF("*** Found %d cards with %d requests, %lu us", *numCards, stats.requests, stats.timeUs);
+  PN5180DEBUG_PRINTLN();
+  PN5180DEBUG_EXIT;
+  return rc;
+}
+
+/*
+ * Maximum response time of a command from the PMm byte param (2..7):
+ * T0 * ((B + 1) * n + (A + 1)) * 4^E, with A = bits 2..0, B = bits 5..3 and
+ * E = bits 7..6
+ */
+uint32_t PN5180FeliCa::responseTimeUs(const FeliCaCard *card, uint8_t param, uint8_t n) {
+  uint8_t p = card->pmm[param];
+  uint32_t a = p & 0x07;
+  uint32_t b = (p >> 3) & 0x07;
+  uint8_t e = p >> 6;
+  return (FELICA_T0_US * ((b + 1) * n + (a + 1))) << (2 * e);
+}
+
+/*
+ * Read Without Encryption, code=06
+ *
+ * Request format: LEN, 0x06, IDm (8), Number of services (1), Service code (2, LSB first),
+ *                 Number of blocks, Block list (2 or 3 bytes per block)
+ * Response format: LEN, 0x07, IDm (8), Status flag 1, Status flag 2, Number of blocks, Block data
+ *
+ * Reads numBlocks consecutive blocks of one service into data, with upto
+ * FELICA_READ_BLOCKS blocks per command. statusFlags (optional, 2 bytes)
+ * receives the status flags of a failed command.
+ */
+FeliCaErrorCode PN5180FeliCa::readWithoutEncryption(const FeliCaCard *card, uint16_t serviceCode, uint16_t blockNo, uint8_t numBlocks,
+                                                    uint8_t *data, uint8_t *statusFlags) {
+  PN5180DEBUG_PRINTF("PN5180FeliCa::readWithoutEncryption(serviceCode=0x%04X, blockNo=%d, numBlocks=%d)", serviceCode, blockNo, numBlocks);
+  PN5180DEBUG_PRINTLN();
+  PN5180DEBUG_ENTER;
+  if (statusFlags) statusFlags[0] = statusFlags[1] = 0;
+  if (!setBitRate(card->bitRate)) {
+    PN5180DEBUG_EXIT;
+    return FELICA_EC_COMMAND_FAILED;
+  }
+
+  uint8_t cmd[14 + 3 * FELICA_READ_BLOCKS];
+  uint8_t resp[FELICA_READ_RES_LEN(FELICA_READ_BLOCKS)];
+  uint16_t len;
+  while (numBlocks > 0) {
+    uint8_t n = (numBlocks > FELICA_READ_BLOCKS) ? FELICA_READ_BLOCKS : numBlocks;
+    uint8_t pos = 0;
+    cmd[pos++] = 0;                // LEN, set below
+    cmd[pos++] = FELICA_CMD_READ_WO_ENC;
+    memcpy(&cmd[pos], card->idm, 8);
+    pos += 8;
+    cmd[pos++] = 1;
+    cmd[pos++] = (uint8_t)serviceCode;
+    cmd[pos++] = (uint8_t)(serviceCode >> 8);
+    cmd[pos++] = n;
+    for (uint8_t i=0; i<n; i++) {
+      uint16_t b = blockNo + i;
+      if (b < 0x100) {             // 2 byte block list element
+        cmd[pos++] = 0x80;
+        cmd[pos++] = (uint8_t)b;
+      }
+      else {                       // 3 byte block list element
+        cmd[pos++] = 0x00;
+        cmd[pos++] = (uint8_t)b;
+        cmd[pos++] = (uint8_t)(b >> 8);
+      }
+    }
+    cmd[0] = pos;
+
+    uint32_t sofTimeoutUs = FELICA_FRAME_US(pos) + responseTimeUs(card, 5, n) + FELICA_MARGIN_US;
+    FeliCaErrorCode rc = transceive(cmd, pos, resp, FELICA_READ_RES_LEN(n), &len, sofTimeoutUs);
+    if ((FELICA_EC_OK == rc) && ((len < 12) || (0 != memcmp(&resp[2], card->idm, 8)))) {
+      rc = FELICA_EC_PROTOCOL;
+    }
+    if ((FELICA_EC_OK == rc) && (0 != resp[10])) {
+      PN5180DEBUG_PRINTF("*** Status flags 0x%02X 0x%02X", resp[10], resp[11]);
+      PN5180DEBUG_PRINTLN();
+      if (statusFlags) {
+        statusFlags[0] = resp[10];
+        statusFlags[1] = resp[11];
+      }
+      rc = FELICA_EC_STATUS;
+    }
+    if ((FELICA_EC_OK == rc) && ((len != FELICA_READ_RES_LEN(n)) || (resp[12] != n))) {
+      rc = FELICA_EC_PROTOCOL;
+    }
+    if (FELICA_EC_OK != rc) {
+      PN5180DEBUG_EXIT;
+      return rc;
+    }
+    memcpy(data, &resp[13], FELICA_BLOCK_SIZE * n);
+    data += FELICA_BLOCK_SIZE * n;
+    blockNo += n;
+    numBlocks -= n;
+  }
+
+  PN5180DEBUG_EXIT;
+  return FELICA_EC_OK;
+}
+
+/*
+ * TX configuration 0x08/0x09 and RX configuration 0x88/0x89,
+ * FeliCa at 212 and 424 kbit/s. loadRFConfig() skips an unchanged
+ * configuration.
+ */
+bool PN5180FeliCa::setBitRate(uint8_t br) {
+  if (!loadRFConfig(0x08 + br, 0x88 + br)) {
+    return false;
+  }
+  bitRate = br;
+  return true;
+}
+
+bool PN5180FeliCa::setupRF(uint8_t bitRate) {
+  preferredBitRate = bitRate & 0x01;
+  if (!configureRF()) return false;
+
+  PN5180DEBUG(F("Turning ON RF field...\n"));
+  if (setRF_on()) {
+    PN5180DEBUG(F("done.\n"));
+  }
+  else return false;
+
+  return true;
+}
+
+/*
+ * Load the FeliCa RF configuration at the preferred bit rate without
+ * switching the field, e.g. after another protocol used the PN5180 with
+ * the field kept on.
+ */
+bool PN5180FeliCa::configureRF() {
+  PN5180DEBUG(F("Loading RF-Configuration...\n"));
+  if (loadRFConfig(0x08 + preferredBitRate, 0x88 + preferredBitRate)) {  // FeliCa parameters
+    PN5180DEBUG(F("done.\n"));
+  }
+  else return false;
+  bitRate = preferredBitRate;
+
+  // OFF Crypto, CRC in both directions (may be changed by Type A commands)
+  writeRegisterWithAndMask(SYSTEM_CONFIG, 0xFFFFFFBF);
+  writeRegisterWithOrMask(CRC_RX_CONFIG, 0x00000001);
+  writeRegisterWithOrMask(CRC_TX_CONFIG, 0x00000001);
+  return true;
+}
+
+const char *PN5180FeliCa::strerror(FeliCaErrorCode code) {
+  switch (code) {
+    case FELICA_EC_OK: return ("OK!");
+    case FELICA_EC_NO_CARD: return ("No card detected!");
+    case FELICA_EC_TIMEOUT: return ("Reception timeout!");
+    case FELICA_EC_PROTOCOL: return ("Protocol or CRC error!");
+    case FELICA_EC_STATUS: return ("Card returned an error status!");
+    case FELICA_EC_COMMAND_FAILED: return ("PN5180 command failed!");
+    default: return ("Undefined error code in FeliCa!");
+  }
+}
@@ -0,0 +1,97 @@
+// NAME: PN5180FeliCa.h
+//
+// DESC: FeliCa protocol on NXP Semiconductors PN5180 module for Arduino.
+//
+// This file is part of the PN5180 library for the Arduino environment.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+#ifndef PN5180FELICA_H
+#define PN5180FELICA_H
+
+#include "PN5180.h"
+
+enum FeliCaErrorCode {
+  FELICA_EC_OK = 0,
+  FELICA_EC_NO_CARD = 1,
+  FELICA_EC_TIMEOUT = 2,            // reception started but did not end
+  FELICA_EC_PROTOCOL = 3,           // malformed response or CRC error
+  FELICA_EC_STATUS = 4,             // status flags of the card not 0
+  FELICA_EC_COMMAND_FAILED = 5      // host interface command failed
+};
+
+#define FELICA_BR_212  0
+#define FELICA_BR_424  1
+
+// SENSF_REQ system code wildcard
+#define FELICA_SYSTEM_CODE_ANY 0xFFFF
+
+// blocks per Read Without Encryption command, cards support at least 4
+#ifndef FELICA_READ_BLOCKS
+#define FELICA_READ_BLOCKS 4
+#endif
+// upper bound of SENSF_REQ per poll() call, repeated after collisions
+#ifndef FELICA_MAX_POLLS
+#define FELICA_MAX_POLLS 8
+#endif
+
+#define FELICA_BLOCK_SIZE 16
+
+// One card answering SENSF_REQ
+struct FeliCaCard {
+  uint8_t idm[8];
+  uint8_t pmm[8];                   // IC code and maximum response times
+  uint16_t systemCode;
+  uint8_t bitRate;                  // FELICA_BR_212 or FELICA_BR_424
+};
+
+// Statistics of the last poll()
+struct FeliCaPollStats {
+  uint8_t requests;                 // SENSF_REQ sent
+  uint8_t slots;
+  uint8_t errors;                   // collisions and CRC errors
+  unsigned long timeUs;
+};
+
+class PN5180FeliCa : public PN5180 {
+
+public:
+  PN5180FeliCa(uint8_t SSpin, uint8_t BUSYpin, uint8_t RSTpin, SPIClass& spi=SPI);
+
+private:
+  uint8_t bitRate = FELICA_BR_212;        // loaded RF configuration
+  uint8_t preferredBitRate = FELICA_BR_424;
+  FeliCaPollStats stats = { 0, 0, 0, 0 };
+  FeliCaErrorCode transceive(const uint8_t *cmd, uint8_t cmdLen, uint8_t *resp, uint16_t maxLen, uint16_t *len,
+                             uint32_t sofTimeoutUs);
+  FeliCaErrorCode transceiveMultiple(const uint8_t *cmd, uint8_t cmdLen, uint8_t *frames, uint8_t *numFrames,
+                                     uint32_t windowUs);
+  FeliCaErrorCode pollRate(FeliCaCard *cards, uint8_t maxCards, uint8_t *numCards, uint16_t systemCode, uint8_t tsn);
+  bool setBitRate(uint8_t br);
+  uint32_t responseTimeUs(const FeliCaCard *card, uint8_t param, uint8_t n);
+
+public:
+  FeliCaErrorCode poll(FeliCaCard *cards, uint8_t maxCards, uint8_t *numCards, uint16_t systemCode=FELICA_SYSTEM_CODE_ANY,
+                       uint8_t slots=4);
+  FeliCaErrorCode readWithoutEncryption(const FeliCaCard *card, uint16_t serviceCode, uint16_t blockNo, uint8_t numBlocks,
+                                        uint8_t *data, uint8_t *statusFlags=NULL);
+  uint8_t getBitRate() { return bitRate; }
+  const FeliCaPollStats *getPollStats() { return &stats; }
+  /*
+   * Helper functions
+   */
+public:
+  bool setupRF(uint8_t bitRate=FELICA_BR_424);
+  bool configureRF();
+  const char *strerror(FeliCaErrorCode code);
+};
+
+#endif /* PN5180FELICA_H */
@@ -23,15 +23,115 @@
 #include <PN5180.h>
 #include "Debug.h"
 
+// NFC Forum Type 2 tag commands (MIFARE Ultralight, NTAG)
+#define TYPE2_CMD_GET_VERSION     (0x60)
+#define TYPE2_CMD_READ            (0x30)
+#define TYPE2_CMD_FAST_READ       (0x3A)
+#define TYPE2_CMD_WRITE           (0xA2)
+#define TYPE2_PAGE_SIZE           (4)
+// a FAST_READ response must fit into the 508 bytes reception buffer
+#define TYPE2_FAST_READ_MAX_PAGES (127)
+
+// MIFARE (compatibility) WRITE, 16 bytes in two steps
+#define MIFARE_CMD_WRITE          (0xA0)
+// 4 bit ACK, everything else is a NAK
+#define MIFARE_ACK                (0x0A)
+#define MIFARE_NO_ANSWER          (0xFF)
+// ACK after the EEPROM has been programmed (typ. 4.1ms)
+#define TYPEA_WRITE_TIMEOUT_US    (10000UL)
+
+// Presence check: the SOF of an answer is seen a few 100us after the command
+#define TYPEA_PRESENCE_TIMEOUT_US (500UL)
+// a NAK or ATQA is complete shortly after its SOF, 16 data bytes take >1ms
+#define TYPEA_SHORT_FRAME_US      (300UL)
+// ISO14443-4 presence check: R(NAK) with block number 0, the card answers
+// R(ACK) within the frame waiting time 256*16/fc * 2^FWI (FWI=4 if not in the ATS)
+#define ISODEP_R_NAK              (0xB2)
+#define ISODEP_FWT_US(fwi)        (302UL << (fwi))
+// HLTA with precomputed CRC_A, sent with TX CRC disabled
+#define TYPEA_HLTA_TIMEOUT_US     (600UL)
+
+// MIFARE Ultralight C has 48 pages, its key pages 0x2C..0x2F cannot be read.
+// It answers AUTHENTICATE (step 1) with 0xAF and ek(RndB), MIFARE Ultralight
+// and NTAG203 (no GET_VERSION either) do not.
+#define ULTRALIGHT_C_CMD_AUTH     (0x1A)
+#define ULTRALIGHT_C_AUTH_LEN     (9)
+#define ULTRALIGHT_C_NUM_PAGES    (48)
+#define ULTRALIGHT_C_USER_PAGES   (36)
+#define ULTRALIGHT_C_KEY_PAGE     (0x2C)
+
+// Frame delay time plus ~85us per byte (8 data bits + parity) at 106 kbit/s
+#define TYPEA_RESPONSE_TIMEOUT_US(len) (5000UL + 100UL * (len))
+
+// Card type lookup table, first matching entry wins.
+// ATQA is compared as received (LSB first), an atqaMask of 0 matches any ATQA.
+// Block counts of MIFARE Classic/Plus include sector trailers.
+struct ISO14443CardTypeEntry {
+	uint8_t sak;
+	uint16_t atqaMask;
+	uint16_t atqa;
+	ISO14443CardType type;
+	const char *name;
+	uint8_t blockSize;
+	uint16_t numBlocks;
+	uint16_t firstUserBlock;
+	uint16_t numUserBlocks;
+};
+
+static const ISO14443CardTypeEntry cardTypeTable[] = {
+	// sak  atqaMask atqa   type                              name                            bs  blocks 1st  user
+	{ 0x09, 0x0000, 0x0000, ISO14443_CARD_MIFARE_MINI,       "MIFARE Mini",                   16,  20,  1,  19 },
+	{ 0x08, 0x0000, 0x0000, ISO14443_CARD_MIFARE_CLASSIC_1K, "MIFARE Classic 1K",             16,  64,  1,  63 },
+	{ 0x88, 0x0000, 0x0000, ISO14443_CARD_MIFARE_CLASSIC_1K, "MIFARE Classic 1K (Infineon)",  16,  64,  1,  63 },
+	{ 0x28, 0x0000, 0x0000, ISO14443_CARD_MIFARE_CLASSIC_1K, "SmartMX with MIFARE Classic 1K", 16, 64,  1,  63 },
+	{ 0x18, 0x0000, 0x0000, ISO14443_CARD_MIFARE_CLASSIC_4K, "MIFARE Classic 4K",             16, 256,  1, 255 },
+	{ 0x38, 0x0000, 0x0000, ISO14443_CARD_MIFARE_CLASSIC_4K, "SmartMX with MIFARE Classic 4K", 16, 256, 1, 255 },
+	{ 0x00, 0xFFFF, 0x0044, ISO14443_CARD_MIFARE_ULTRALIGHT, "MIFARE Ultralight",              4,  16,  4,  12 },
+	{ 0x10, 0x0000, 0x0000, ISO14443_CARD_MIFARE_PLUS_2K,    "MIFARE Plus 2K (SL2)",          16, 128,  1, 127 },
+	{ 0x11, 0x0000, 0x0000, ISO14443_CARD_MIFARE_PLUS_4K,    "MIFARE Plus 4K (SL2)",          16, 256,  1, 255 },
+	{ 0x20, 0xFFFF, 0x0344, ISO14443_CARD_ISO_DEP,           "MIFARE DESFire",                 0,   0,  0,   0 },
+	{ 0x20, 0x0000, 0x0000, ISO14443_CARD_ISO_DEP,           "ISO14443-4",                     0,   0,  0,   0 },
+};
+
+// Refinement of Type 2 tags by GET_VERSION (product type, storage size)
+struct ISO14443VersionEntry {
+	uint8_t productType;
+	uint8_t storageSize;
+	ISO14443CardType type;
+	const char *name;
+	uint16_t numPages;
+	uint16_t numUserPages;
+};
+
+static const ISO14443VersionEntry versionTable[] = {
+	{ 0x03, 0x0B, ISO14443_CARD_MIFARE_ULTRALIGHT_EV1, "MIFARE Ultralight EV1 (MF0UL11)",  20,  12 },
+	{ 0x03, 0x0E, ISO14443_CARD_MIFARE_ULTRALIGHT_EV1, "MIFARE Ultralight EV1 (MF0UL21)",  41,  32 },
+	{ 0x04, 0x0B, ISO14443_CARD_NTAG,                  "NTAG210",                          20,  12 },
+	{ 0x04, 0x0E, ISO14443_CARD_NTAG,                  "NTAG212",                          41,  32 },
+	{ 0x04, 0x0F, ISO14443_CARD_NTAG,                  "NTAG213",                          45,  36 },
+	{ 0x04, 0x11, ISO14443_CARD_NTAG,                  "NTAG215",                         135, 126 },
+	{ 0x04, 0x13, ISO14443_CARD_NTAG,                  "NTAG216",                         231, 222 },
+};
+
+// Fastest read method per card type, used by readAll()
+const PN5180ISO14443::ReadStrategyEntry PN5180ISO14443::readStrategies[] = {
+	{ ISO14443_CARD_MIFARE_MINI,           &PN5180ISO14443::readClassic },
+	{ ISO14443_CARD_MIFARE_CLASSIC_1K,     &PN5180ISO14443::readClassic },
+	{ ISO14443_CARD_MIFARE_CLASSIC_4K,     &PN5180ISO14443::readClassic },
+	{ ISO14443_CARD_MIFARE_ULTRALIGHT,     &PN5180ISO14443::readType2Compat },
+	{ ISO14443_CARD_MIFARE_ULTRALIGHT_C,   &PN5180ISO14443::readType2Compat },
+	{ ISO14443_CARD_MIFARE_ULTRALIGHT_EV1, &PN5180ISO14443::readType2Fast },
+	{ ISO14443_CARD_NTAG,                  &PN5180ISO14443::readType2Fast },
+};
+
 PN5180ISO14443::PN5180ISO14443(uint8_t SSpin, uint8_t BUSYpin, uint8_t RSTpin, SPIClass& spi) 
               : PN5180(SSpin, BUSYpin, RSTpin, spi) {
 }
 
 bool PN5180ISO14443::setupRF() {
-  PN5180DEBUG_PRINTLN(F("Loading RF-Configuration..."));
   PN5180DEBUG_ENTER;
   
-  if (loadRFConfig(0x00, 0x80)) {  // ISO14443 parameters
+  if (configureRF()) {
     PN5180DEBUG_PRINTLN(F("done."));
   }
   else {
@@ -51,6 +151,15 @@ bool PN5180ISO14443::setupRF() {
   return true;
 }
 
+/*
+ * Load the ISO14443A RF configuration without switching the field, e.g.
+ * after another protocol used the PN5180 with the field kept on.
+ */
+bool PN5180ISO14443::configureRF() {
+  PN5180DEBUG_PRINTLN(F("Loading RF-Configuration..."));
+  return loadRFConfig(0x00, 0x80);  // ISO14443 parameters
+}
+
 
 uint16_t PN5180ISO14443::rxBytesReceived() {
 	PN5180DEBUG_PRINTLN(F("PN5180ISO14443::rxBytesReceived()"));	
@@ -88,6 +197,9 @@ uint16_t PN5180ISO14443::rxBytesReceived() {
 int8_t PN5180ISO14443::activateTypeA(uint8_t *buffer, uint8_t kind) {
 	uint8_t cmd[7];
 	uint8_t uidLength = 0;
+	cardSelected = false;
+	isoDep = false;
+	type2FastRead = false;
 	
 	PN5180DEBUG_PRINTF(F("PN5180ISO14443::activateTypeA(*buffer, kind=%d)"), kind);
 	PN5180DEBUG_PRINTLN();
@@ -101,9 +213,10 @@ int8_t PN5180ISO14443::activateTypeA(uint8_t *buffer, uint8_t kind) {
 	}
 
 	// activate RF field
+	bool rampUp = !isRFOn();
 	setRF_on();
 	// wait RF-field to ramp-up
-	delay(10);
+	if (rampUp) delay(10);
 	
 	// OFF Crypto
 	if (!writeRegisterWithAndMask(SYSTEM_CONFIG, 0xFFFFFFBF)) {
@@ -307,23 +420,130 @@ int8_t PN5180ISO14443::activateTypeA(uint8_t *buffer, uint8_t kind) {
 		}
 		uidLength = 7;
 	}
+	cardSelected = true;
+	selectedSession = getRFSession();
+	memcpy(selectedUid, buffer + 3, uidLength);
+	selectedUidLength = uidLength;
 	PN5180DEBUG_EXIT;
     return uidLength;
 }
 
+/*
+* Send a frame to the activated card and wait for the end of the RF reception
+* (RX_IRQ) instead of a fixed delay.
+* return value: number of bytes received, 0 if the card did not answer in time
+*/
+uint16_t PN5180ISO14443::transceiveTypeA(const uint8_t *cmd, uint8_t cmdLen, uint32_t timeoutUs) {
+	clearIRQStatus(RX_IRQ_STAT | TX_IRQ_STAT | IDLE_IRQ_STAT | GENERAL_ERROR_IRQ_STAT);
+	if (!sendData(cmd, cmdLen, 0x00)) {
+		return 0;
+	}
+	if (!waitForIRQ(RX_IRQ_STAT, timeoutUs)) {
+		return 0;
+	}
+	return rxBytesReceived();
+}
+
+/*
+* Re-select a known card by its cached UID, skipping the anticollision loop.
+* uid       : 4 or 7 byte UID as returned by readCardSerial()
+* buffer    : must be 10 byte array, same layout as for activateTypeA()
+* Sends WUPA and then SELECT with the complete UID of each cascade level,
+* i.e. two RF exchanges for a 4 byte UID and three for a 7 byte UID.
+* The card has to be in IDLE or HALT state (e.g. after mifareHalt()).
+* If SELECT fails, a full activateTypeA(buffer, 1) follows. Its result is
+* only accepted for the same UID, another card selected that way is halted.
+*
+* return value: the uid length if the card with this UID is selected
+* - zero if no card answered WUPA
+* - -1 general error or invalid uidLength
+* - -2 the card with this UID could not be selected
+*/
+int8_t PN5180ISO14443::reactivateTypeA(const uint8_t *uid, uint8_t uidLength, uint8_t *buffer) {
+	PN5180DEBUG_PRINTF(F("PN5180ISO14443::reactivateTypeA(*uid, uidLength=%d, *buffer)"), uidLength);
+	PN5180DEBUG_PRINTLN();
+	PN5180DEBUG_ENTER;
+
+	cardSelected = false;
+	isoDep = false;
+	bool rampUp = !isRFOn();
+	if (((uidLength != 4) && (uidLength != 7)) || !setupRF()) {
+		PN5180DEBUG_EXIT;
+		return -1;
+	}
+	// wait RF-field to ramp-up
+	if (rampUp) delay(10);
+
+	// OFF Crypto, clear RX and TX CRC for WUPA
+	writeRegisterWithAndMask(SYSTEM_CONFIG, 0xFFFFFFBF);
+	writeRegisterWithAndMask(CRC_RX_CONFIG, 0xFFFFFFFE);
+	writeRegisterWithAndMask(CRC_TX_CONFIG, 0xFFFFFFFE);
+
+	//Send WUPA, 7 bits in last byte
+	uint8_t cmd[7];
+	cmd[0] = 0x52;
+	clearIRQStatus(RX_IRQ_STAT | TX_IRQ_STAT | IDLE_IRQ_STAT | GENERAL_ERROR_IRQ_STAT);
+	if (!sendData(cmd, 1, 0x07) || !waitForIRQ(RX_IRQ_STAT, TYPEA_RESPONSE_TIMEOUT_US(2)) ||
+	    (rxBytesReceived() != 2) || !readData(2, buffer)) {
+		PN5180DEBUG_PRINTLN(F("No ATQA"));
+		PN5180DEBUG_EXIT;
+		return 0;
+	}
+
+	//Enable RX and TX CRC calculation for SELECT
+	writeRegisterWithOrMask(CRC_RX_CONFIG, 0x01);
+	writeRegisterWithOrMask(CRC_TX_CONFIG, 0x01);
+
+	uint8_t levels = (uidLength == 4) ? 1 : 2;
+	for (uint8_t level = 0; level < levels; level++) {
+		cmd[0] = (level == 0) ? 0x93 : 0x95;
+		cmd[1] = 0x70;
+		if ((level == 0) && (uidLength == 7)) {
+			// cascade tag followed by the first 3 UID bytes
+			cmd[2] = 0x88;
+			for (int i = 0; i < 3; i++) cmd[3 + i] = uid[i];
+		}
+		else {
+			for (int i = 0; i < 4; i++) cmd[2 + i] = uid[(level == 0) ? i : 3 + i];
+		}
+		cmd[6] = cmd[2] ^ cmd[3] ^ cmd[4] ^ cmd[5]; // BCC
+		// SAK: bit 3 set if the UID is not complete
+		if ((transceiveTypeA(cmd, 7, TYPEA_RESPONSE_TIMEOUT_US(1)) != 1) || !readData(1, buffer + 2) ||
+		    (((buffer[2] & 0x04) != 0) != (level + 1 < levels))) {
+			PN5180DEBUG_PRINTLN(F("*** SELECT of the UID failed, full anticollision"));
+			int8_t len = activateTypeA(buffer, 1);
+			if ((len == uidLength) && (0 == memcmp(buffer + 3, uid, uidLength))) {
+				PN5180DEBUG_EXIT;
+				return uidLength;
+			}
+			if (len > 0) {
+				mifareHalt();  // another card, leave it alone
+			}
+			PN5180DEBUG_EXIT;
+			return -2;
+		}
+	}
+	for (int i = 0; i < uidLength; i++) buffer[3 + i] = uid[i];
+
+	cardSelected = true;
+	selectedSession = getRFSession();
+	memcpy(selectedUid, buffer + 3, uidLength);
+	selectedUidLength = uidLength;
+	PN5180DEBUG_EXIT;
+	return uidLength;
+}
+
 bool PN5180ISO14443::mifareBlockRead(uint8_t blockno, uint8_t *buffer) {
 	bool success = false;
 	uint16_t len;
 	uint8_t cmd[2];
 	// Send mifare command 30,blockno
-	cmd[0] = 0x30;
+	cmd[0] = TYPE2_CMD_READ;
 	cmd[1] = blockno;
-	if (!sendData(cmd, 2, 0x00))
-	  return false;
 	//Check if we have received any data from the tag
-	delay(5);
-	len = rxBytesReceived();
+	len = transceiveTypeA(cmd, 2, TYPEA_RESPONSE_TIMEOUT_US(16));
 	if (len == 16) {
+		lastReadBlock = blockno;
 		// READ 16 bytes into  buffer
 		if (readData(16, buffer))
 		  success = true;
@@ -332,27 +552,553 @@ bool PN5180ISO14443::mifareBlockRead(uint8_t blockno, uint8_t *buffer) {
 }
 
 
+/*
+* Wait for the 4 bit ACK/NAK of a write command.
+* RX CRC must be disabled, since the ACK has no CRC.
+* return value: ACK/NAK nibble, MIFARE_NO_ANSWER on timeout
+*/
+uint8_t PN5180ISO14443::waitForAck(uint32_t timeoutUs) {
+	if (!waitForIRQ(RX_IRQ_STAT, timeoutUs)) {
+		return MIFARE_NO_ANSWER;
+	}
+	if (rxBytesReceived() == 0) {
+		return MIFARE_NO_ANSWER;
+	}
+	uint8_t ack;
+	if (!readData(1, &ack)) {
+		return MIFARE_NO_ANSWER;
+	}
+	return ack & 0x0F;
+}
+
+/*
+* Write one block/page, paced on the reception IRQ of the ACK.
+* len == 16: MIFARE WRITE (A0, blockno / 16 data bytes)
+* len == 4 : Type 2 WRITE (A2, page, 4 data bytes)
+* RX CRC must be disabled by the caller.
+* return value: MIFARE_ACK, the NAK nibble or MIFARE_NO_ANSWER
+*/
+uint8_t PN5180ISO14443::writeBlockNoRxCRC(uint8_t blockno, const uint8_t *data, uint8_t len) {
+	uint8_t cmd[6];
+	uint8_t ack;
+
+	if (len == 16) {
+		// Mifare write part 1
+		cmd[0] = MIFARE_CMD_WRITE;
+		cmd[1] = blockno;
+		clearIRQStatus(RX_IRQ_STAT | TX_IRQ_STAT | IDLE_IRQ_STAT | GENERAL_ERROR_IRQ_STAT);
+		if (!sendData(cmd, 2, 0x00)) {
+			return MIFARE_NO_ANSWER;
+		}
+		ack = waitForAck(TYPEA_RESPONSE_TIMEOUT_US(1));
+		if (ack != MIFARE_ACK) {
+			return ack;
+		}
+		// Mifare write part 2
+		clearIRQStatus(RX_IRQ_STAT | TX_IRQ_STAT | IDLE_IRQ_STAT | GENERAL_ERROR_IRQ_STAT);
+		if (!sendData(data, 16, 0x00)) {
+			return MIFARE_NO_ANSWER;
+		}
+	}
+	else if (len == TYPE2_PAGE_SIZE) {
+		cmd[0] = TYPE2_CMD_WRITE;
+		cmd[1] = blockno;
+		for (int i = 0; i < TYPE2_PAGE_SIZE; i++) cmd[2 + i] = data[i];
+		clearIRQStatus(RX_IRQ_STAT | TX_IRQ_STAT | IDLE_IRQ_STAT | GENERAL_ERROR_IRQ_STAT);
+		if (!sendData(cmd, 6, 0x00)) {
+			return MIFARE_NO_ANSWER;
+		}
+	}
+	else {
+		return MIFARE_NO_ANSWER;
+	}
+	// Read ACK/NAK
+	return waitForAck(TYPEA_WRITE_TIMEOUT_US);
+}
+
 uint8_t PN5180ISO14443::mifareBlockWrite16(uint8_t blockno, const uint8_t *buffer) {
-	uint8_t cmd[2];
 	// Clear RX CRC
-	writeRegisterWithAndMask(CRC_RX_CONFIG, 0xFFFFFFFE);
+	if (!writeRegisterWithAndMask(CRC_RX_CONFIG, 0xFFFFFFFE)) {
+		return MIFARE_NO_ANSWER;
+	}
 
-	// Mifare write part 1
-	cmd[0] = 0xA0;
-	cmd[1] = blockno;
-	sendData(cmd, 2, 0x00);
-	readData(1, cmd);
+	uint8_t ack = writeBlockNoRxCRC(blockno, buffer, 16);
 
-	// Mifare write part 2
-	sendData(buffer,16, 0x00);
-	delay(10);
+	//Enable RX CRC calculation
+	writeRegisterWithOrMask(CRC_RX_CONFIG, 0x1);
+	return ack;
+}
 
-	// Read ACK/NAK
-	readData(1, cmd);
+/*
+* Write a batch of blocks (16 bytes, MIFARE WRITE) or pages (4 bytes, Type 2 WRITE).
+* blockNos  : numBlocks block/page numbers
+* data      : numBlocks * blockSize bytes, in the order of blockNos
+* status    : numBlocks ISO14443WriteStatus values
+* verify    : read back the written data after the batch. Type 2 pages are
+*             read over consecutive page runs, with FAST_READ if the card
+*             answered GET_VERSION (NTAG, Ultralight EV1), else with READ
+*             (4 pages, Ultralight and Ultralight C).
+* RX CRC is disabled once for the whole batch, each step is paced on the
+* reception IRQ of the ACK/NAK. A NAK or missing ACK puts the card into
+* IDLE state, the remaining blocks are marked ISO14443_WRITE_SKIPPED and
+* the blocks written before are not verified (they keep ISO14443_WRITE_OK).
+* return value: number of blocks written (and verified) successfully
+*/
+uint8_t PN5180ISO14443::writeBlocks(const uint8_t *blockNos, const uint8_t *data, uint8_t numBlocks, uint8_t blockSize, uint8_t *status, bool verify) {
+	PN5180DEBUG_PRINTF(F("PN5180ISO14443::writeBlocks(numBlocks=%d, blockSize=%d, verify=%d)"), numBlocks, blockSize, verify);
+	PN5180DEBUG_PRINTLN();
+	PN5180DEBUG_ENTER;
 
+	for (int i = 0; i < numBlocks; i++) status[i] = ISO14443_WRITE_SKIPPED;
+	if ((blockSize != 16) && (blockSize != TYPE2_PAGE_SIZE)) {
+		PN5180DEBUG_PRINTLN(F("*** ERROR: invalid block size!"));
+		PN5180DEBUG_EXIT;
+		return 0;
+	}
+
+	// Clear RX CRC for the whole batch, the ACK has no CRC
+	if (!writeRegisterWithAndMask(CRC_RX_CONFIG, 0xFFFFFFFE)) {
+		PN5180DEBUG_EXIT;
+		return 0;
+	}
+	uint8_t written = 0;
+	bool failed = false;
+	for (int i = 0; i < numBlocks; i++) {
+		uint8_t ack = writeBlockNoRxCRC(blockNos[i], data + i * blockSize, blockSize);
+		if (ack == MIFARE_ACK) {
+			status[i] = ISO14443_WRITE_OK;
+			written++;
+			continue;
+		}
+		PN5180DEBUG_PRINTF(F("*** ERROR: block %d not acknowledged (0x%02X)"), blockNos[i], ack);
+		PN5180DEBUG_PRINTLN();
+		status[i] = (ack == MIFARE_NO_ANSWER) ? ISO14443_WRITE_TIMEOUT : ISO14443_WRITE_NAK;
+		cardSelected = false;
+		failed = true;
+		break;
+	}
 	//Enable RX CRC calculation
-	writeRegisterWithOrMask(CRC_RX_CONFIG, 0x1);
-	return cmd[0];
+	writeRegisterWithOrMask(CRC_RX_CONFIG, 0x01);
+
+	if (!verify || failed) {
+		// after a NAK the card is IDLE, a read back would fail
+		PN5180DEBUG_EXIT;
+		return written;
+	}
+
+	uint8_t readBack[32 * TYPE2_PAGE_SIZE];
+	int i = 0;
+	while (i < numBlocks) {
+		if (status[i] != ISO14443_WRITE_OK) {
+			i++;
+			continue;
+		}
+		// find a run of consecutive pages which can be read at once
+		int run = 1;
+		int maxRun = type2FastRead ? 32 : 4;
+		if (blockSize == TYPE2_PAGE_SIZE) {
+			while ((i + run < numBlocks) && (run < maxRun) &&
+			       (status[i + run] == ISO14443_WRITE_OK) &&
+			       (blockNos[i + run] == blockNos[i] + run)) {
+				run++;
+			}
+		}
+		bool ok;
+		if ((blockSize == TYPE2_PAGE_SIZE) && type2FastRead) {
+			ok = ntagFastRead(blockNos[i], blockNos[i] + run - 1, readBack);
+		}
+		else {
+			ok = mifareBlockRead(blockNos[i], readBack);
+		}
+		for (int j = 0; j < run; j++) {
+			if (!ok || memcmp(readBack + j * blockSize, data + (i + j) * blockSize, blockSize) != 0) {
+				status[i + j] = ISO14443_WRITE_VERIFY_FAILED;
+				written--;
+			}
+		}
+		i += run;
+	}
+
+	PN5180DEBUG_EXIT;
+	return written;
+}
+
+/*
+* GET_VERSION, code=60
+* buffer : must be 8 byte array
+* buffer[0] fixed header (0x00)
+* buffer[1] vendor ID (0x04 = NXP)
+* buffer[2] product type (0x03 = Ultralight, 0x04 = NTAG)
+* buffer[3] product subtype
+* buffer[4..5] major/minor product version
+* buffer[6] storage size
+* buffer[7] protocol type (0x03 = ISO14443-3)
+* MIFARE Ultralight and Ultralight C do not support this command, they
+* answer with a NAK and fall back into IDLE state.
+*/
+bool PN5180ISO14443::ntagGetVersion(uint8_t *version) {
+	PN5180DEBUG_PRINTLN(F("PN5180ISO14443::ntagGetVersion(*version)"));
+	PN5180DEBUG_ENTER;
+
+	uint8_t cmd[1] = { TYPE2_CMD_GET_VERSION };
+	if (transceiveTypeA(cmd, 1, TYPEA_RESPONSE_TIMEOUT_US(8)) != 8) {
+		PN5180DEBUG_PRINTLN(F("*** ERROR: GET_VERSION not answered!"));
+		PN5180DEBUG_EXIT;
+		return false;
+	}
+	bool ret = readData(8, version);
+	type2FastRead = ret;
+
+	PN5180DEBUG_EXIT;
+	return ret;
+}
+
+/*
+* FAST_READ, code=3A
+* Reads the pages startPage..endPage (inclusive) with a single command.
+* The response has to fit into the 508 bytes reception buffer of the PN5180,
+* so at most 127 pages can be read at once. Use type2ReadPages() to read
+* larger ranges.
+*/
+bool PN5180ISO14443::ntagFastRead(uint8_t startPage, uint8_t endPage, uint8_t *buffer) {
+	PN5180DEBUG_PRINTF(F("PN5180ISO14443::ntagFastRead(startPage=%d, endPage=%d, *buffer)"), startPage, endPage);
+	PN5180DEBUG_PRINTLN();
+	PN5180DEBUG_ENTER;
+
+	if ((endPage < startPage) || ((endPage - startPage) >= TYPE2_FAST_READ_MAX_PAGES)) {
+		PN5180DEBUG_PRINTLN(F("*** ERROR: invalid page range!"));
+		PN5180DEBUG_EXIT;
+		return false;
+	}
+	uint16_t len = (uint16_t)(endPage - startPage + 1) * TYPE2_PAGE_SIZE;
+
+	uint8_t cmd[3] = { TYPE2_CMD_FAST_READ, startPage, endPage };
+	if (transceiveTypeA(cmd, sizeof(cmd), TYPEA_RESPONSE_TIMEOUT_US(len)) != len) {
+		PN5180DEBUG_PRINTLN(F("*** ERROR: FAST_READ failed!"));
+		PN5180DEBUG_EXIT;
+		return false;
+	}
+	bool ret = readData(len, buffer);
+
+	PN5180DEBUG_EXIT;
+	return ret;
+}
+
+/*
+* Read numPages pages starting at startPage into buffer (numPages * 4 bytes).
+* The range is split into as few FAST_READ commands as the reception buffer
+* allows. If the tag does not support FAST_READ (MIFARE Ultralight), the
+* card is woken up again and read with 16 byte READ commands.
+*/
+bool PN5180ISO14443::type2ReadPages(uint8_t startPage, uint16_t numPages, uint8_t *buffer) {
+	PN5180DEBUG_PRINTF(F("PN5180ISO14443::type2ReadPages(startPage=%d, numPages=%d, *buffer)"), startPage, numPages);
+	PN5180DEBUG_PRINTLN();
+	PN5180DEBUG_ENTER;
+
+	if ((numPages == 0) || ((startPage + numPages) > 256)) {
+		PN5180DEBUG_EXIT;
+		return false;
+	}
+
+	uint16_t page = startPage;
+	uint16_t endPage = startPage + numPages; // exclusive
+	while (page < endPage) {
+		uint16_t chunk = endPage - page;
+		if (chunk > TYPE2_FAST_READ_MAX_PAGES) chunk = TYPE2_FAST_READ_MAX_PAGES;
+		if (!ntagFastRead(page, page + chunk - 1, buffer + (page - startPage) * TYPE2_PAGE_SIZE)) {
+			break;
+		}
+		page += chunk;
+	}
+	if (page == endPage) {
+		PN5180DEBUG_EXIT;
+		return true;
+	}
+
+	// FAST_READ not supported, the NAK has set the card into IDLE state
+	PN5180DEBUG_PRINTLN(F("FAST_READ failed, fall back to READ"));
+	uint8_t response[10];
+	if (activateTypeA(response, 1) < 4) {
+		PN5180DEBUG_EXIT;
+		return false;
+	}
+	uint8_t block[16];
+	while (page < endPage) {
+		if (!mifareBlockRead(page, block)) {
+			PN5180DEBUG_EXIT;
+			return false;
+		}
+		uint16_t chunk = endPage - page;
+		if (chunk > 4) chunk = 4;
+		memcpy(buffer + (page - startPage) * TYPE2_PAGE_SIZE, block, chunk * TYPE2_PAGE_SIZE);
+		page += chunk;
+	}
+
+	PN5180DEBUG_EXIT;
+	return true;
+}
+
+/*
+* Total number of pages of a Type 2 tag, derived from the storage size
+* byte of the GET_VERSION response. Returns 0 if the size is unknown.
+*/
+uint16_t PN5180ISO14443::type2NumPages(const uint8_t *version) {
+	switch (version[6]) {
+		case 0x0B: return 20;   // NTAG210, MF0UL11
+		case 0x0E: return 41;   // NTAG212, MF0UL21
+		case 0x0F: return 45;   // NTAG213
+		case 0x11: return 135;  // NTAG215
+		case 0x13: return 231;  // NTAG216
+		default:
+			// user memory is 2^n bytes, bits 7-1 hold n; add 4 header pages
+			if (version[6] >= 0x06 && version[6] <= 0x14) {
+				return 4 + ((1 << (version[6] >> 1)) / TYPE2_PAGE_SIZE);
+			}
+			return 0;
+	}
+}
+
+/*
+* Read the whole memory of a Type 2 tag into buffer.
+* The memory size is taken from GET_VERSION, tags without GET_VERSION
+* support are read as MIFARE Ultralight (16 pages).
+* return value: number of bytes read, -1 on error
+*/
+int16_t PN5180ISO14443::type2ReadMemory(uint8_t *buffer, uint16_t bufferSize) {
+	PN5180DEBUG_PRINTF(F("PN5180ISO14443::type2ReadMemory(*buffer, bufferSize=%d)"), bufferSize);
+	PN5180DEBUG_PRINTLN();
+	PN5180DEBUG_ENTER;
+
+	uint8_t version[8];
+	uint16_t numPages = 0;
+	if (ntagGetVersion(version)) {
+		numPages = type2NumPages(version);
+	}
+	else {
+		// the NAK has set the card into IDLE state, wake it up again
+		uint8_t response[10];
+		if (activateTypeA(response, 1) < 4) {
+			PN5180DEBUG_EXIT;
+			return -1;
+		}
+	}
+	if (numPages == 0) numPages = 16;
+	if (numPages * TYPE2_PAGE_SIZE > bufferSize) numPages = bufferSize / TYPE2_PAGE_SIZE;
+
+	if (!type2ReadPages(0, numPages, buffer)) {
+		PN5180DEBUG_EXIT;
+		return -1;
+	}
+
+	PN5180DEBUG_EXIT;
+	return numPages * TYPE2_PAGE_SIZE;
+}
+
+/*
+* Activate a card (WUPA) and classify it by SAK and ATQA. Type 2 tags are
+* refined with GET_VERSION, for ISO-DEP cards the ATS is requested with
+* RATS if requestAts is set (the card is in ISO14443-4 state afterwards).
+* The card stays selected, so it can be read with readAll() directly.
+*
+* return value: the uid length, see activateTypeA()
+*/
+int8_t PN5180ISO14443::identifyCard(ISO14443CardInfo *card, bool requestAts) {
+	PN5180DEBUG_PRINTLN(F("PN5180ISO14443::identifyCard(*card)"));
+	PN5180DEBUG_ENTER;
+
+	memset(card, 0, sizeof(ISO14443CardInfo));
+	card->type = ISO14443_CARD_UNKNOWN;
+	card->name = "Unknown";
+
+	uint8_t response[10];
+	int8_t uidLength = activateTypeA(response, 1);
+	if (uidLength < 4) {
+		PN5180DEBUG_EXIT;
+		return uidLength;
+	}
+	card->atqa[0] = response[0];
+	card->atqa[1] = response[1];
+	card->sak = response[2];
+	card->uidLength = uidLength;
+	for (int i = 0; i < uidLength; i++) card->uid[i] = response[3 + i];
+
+	uint16_t atqa = ((uint16_t)response[1] << 8) | response[0];
+	for (uint8_t i = 0; i < sizeof(cardTypeTable) / sizeof(cardTypeTable[0]); i++) {
+		const ISO14443CardTypeEntry *entry = &cardTypeTable[i];
+		if ((entry->sak == card->sak) && ((atqa & entry->atqaMask) == entry->atqa)) {
+			card->type = entry->type;
+			card->name = entry->name;
+			card->blockSize = entry->blockSize;
+			card->numBlocks = entry->numBlocks;
+			card->firstUserBlock = entry->firstUserBlock;
+			card->numUserBlocks = entry->numUserBlocks;
+			break;
+		}
+	}
+
+	if (card->type == ISO14443_CARD_MIFARE_ULTRALIGHT) {
+		if (ntagGetVersion(card->version)) {
+			card->type = (card->version[2] == 0x04) ? ISO14443_CARD_NTAG : ISO14443_CARD_MIFARE_ULTRALIGHT_EV1;
+			card->name = (card->type == ISO14443_CARD_NTAG) ? "NTAG" : "MIFARE Ultralight EV1";
+			card->numBlocks = type2NumPages(card->version);
+			card->numUserBlocks = (card->numBlocks > 4) ? card->numBlocks - 4 : 0;
+			for (uint8_t i = 0; i < sizeof(versionTable) / sizeof(versionTable[0]); i++) {
+				const ISO14443VersionEntry *entry = &versionTable[i];
+				if ((entry->productType == card->version[2]) && (entry->storageSize == card->version[6])) {
+					card->type = entry->type;
+					card->name = entry->name;
+					card->numBlocks = entry->numPages;
+					card->numUserBlocks = entry->numUserPages;
+					break;
+				}
+			}
+		}
+		else if (reactivateTypeA(card->uid, uidLength, response) < 4) {
+			// the NAK has set the card into IDLE state and it did not come back
+			PN5180DEBUG_EXIT;
+			return -2;
+		}
+		else {
+			uint8_t auth[2] = { ULTRALIGHT_C_CMD_AUTH, 0x00 };
+			uint8_t answer;
+			bool ultralightC = (transceiveTypeA(auth, sizeof(auth), TYPEA_RESPONSE_TIMEOUT_US(ULTRALIGHT_C_AUTH_LEN)) == ULTRALIGHT_C_AUTH_LEN) &&
+			                   readData(1, &answer) && (0xAF == answer);
+			// the unfinished authentication (or the NAK) leaves the card IDLE
+			if (reactivateTypeA(card->uid, uidLength, response) < 4) {
+				PN5180DEBUG_EXIT;
+				return -2;
+			}
+			if (ultralightC) {
+				card->type = ISO14443_CARD_MIFARE_ULTRALIGHT_C;
+				card->name = "MIFARE Ultralight C";
+				card->numBlocks = ULTRALIGHT_C_NUM_PAGES;
+				card->numUserBlocks = ULTRALIGHT_C_USER_PAGES;
+			}
+		}
+	}
+
+	if ((card->type == ISO14443_CARD_ISO_DEP) && requestAts) {
+		// RATS, FSDI=5 (64 bytes), CID=0
+		uint8_t rats[2] = { 0xE0, 0x50 };
+		uint16_t len = transceiveTypeA(rats, sizeof(rats), TYPEA_RESPONSE_TIMEOUT_US(sizeof(card->ats)));
+		if (len > sizeof(card->ats)) len = sizeof(card->ats);
+		if ((len > 0) && readData(len, card->ats)) {
+			card->atsLength = len;
+			// ISO14443-4 state, see isCardPresentFast(); FWI from TB(1)
+			uint8_t fwi = 4;
+			uint8_t tb = (card->ats[1] & 0x10) ? 3 : 2;
+			if ((len > 1) && (card->ats[1] & 0x20) && (tb < len) && ((card->ats[tb] >> 4) < 15)) {
+				fwi = card->ats[tb] >> 4;
+			}
+			isoDepFwtUs = ISODEP_FWT_US(fwi);
+			isoDep = true;
+		}
+	}
+
+	PN5180DEBUG_PRINT(F("Card type: "));
+	PN5180DEBUG_PRINTLN(card->name);
+	PN5180DEBUG_EXIT;
+	return uidLength;
+}
+
+/*
+* Key used by readAll() to authenticate MIFARE Classic sectors,
+* default is the transport key FF FF FF FF FF FF (key A).
+*/
+void PN5180ISO14443::setClassicKey(const uint8_t *key, uint8_t keyType) {
+	for (int i = 0; i < 6; i++) classicKey[i] = key[i];
+	classicKeyType = keyType;
+}
+
+/*
+* Read the memory of a card classified by identifyCard() with the fastest
+* method known for its type, without probing other commands.
+* bytesRead : optional, number of bytes at the start of buffer that were
+*             read, also if the read failed part way
+* return value: number of bytes read
+* - -1 if the card type cannot be read
+* - -2 if a read or (MIFARE Classic) authentication failed
+*/
+int16_t PN5180ISO14443::readAll(const ISO14443CardInfo *card, uint8_t *buffer, uint16_t bufferSize, uint16_t *bytesRead) {
+	PN5180DEBUG_PRINTF(F("PN5180ISO14443::readAll(type=%d, *buffer, bufferSize=%d)"), card->type, bufferSize);
+	PN5180DEBUG_PRINTLN();
+	PN5180DEBUG_ENTER;
+
+	uint16_t len = 0;
+	if (bytesRead) *bytesRead = 0;
+	for (uint8_t i = 0; i < sizeof(readStrategies) / sizeof(readStrategies[0]); i++) {
+		if (readStrategies[i].type == card->type) {
+			int16_t ret = (this->*readStrategies[i].read)(card, buffer, bufferSize, &len);
+			if (bytesRead) *bytesRead = len;
+			PN5180DEBUG_EXIT;
+			return ret;
+		}
+	}
+
+	PN5180DEBUG_PRINTLN(F("*** ERROR: no read strategy for this card type!"));
+	PN5180DEBUG_EXIT;
+	return -1;
+}
+
+// Type 2 tags with FAST_READ support (NTAG, Ultralight EV1)
+int16_t PN5180ISO14443::readType2Fast(const ISO14443CardInfo *card, uint8_t *buffer, uint16_t bufferSize, uint16_t *bytesRead) {
+	uint16_t numPages = card->numBlocks;
+	if (numPages * TYPE2_PAGE_SIZE > bufferSize) numPages = bufferSize / TYPE2_PAGE_SIZE;
+	if (!type2ReadPages(0, numPages, buffer)) {
+		return -2;
+	}
+	*bytesRead = numPages * TYPE2_PAGE_SIZE;
+	return *bytesRead;
+}
+
+// Type 2 tags without FAST_READ (Ultralight, Ultralight C), 4 pages per READ.
+// The key pages of the Ultralight C are write only, they are returned as 00.
+int16_t PN5180ISO14443::readType2Compat(const ISO14443CardInfo *card, uint8_t *buffer, uint16_t bufferSize, uint16_t *bytesRead) {
+	uint16_t numPages = card->numBlocks;
+	if (numPages * TYPE2_PAGE_SIZE > bufferSize) numPages = bufferSize / TYPE2_PAGE_SIZE;
+	uint16_t readablePages = numPages;
+	if ((card->type == ISO14443_CARD_MIFARE_ULTRALIGHT_C) && (readablePages > ULTRALIGHT_C_KEY_PAGE)) {
+		readablePages = ULTRALIGHT_C_KEY_PAGE;
+	}
+	uint8_t block[16];
+	for (uint16_t page = 0; page < readablePages; page += 4) {
+		if (!mifareBlockRead(page, block)) {
+			return -2;
+		}
+		uint16_t chunk = readablePages - page;
+		if (chunk > 4) chunk = 4;
+		memcpy(buffer + page * TYPE2_PAGE_SIZE, block, chunk * TYPE2_PAGE_SIZE);
+		*bytesRead = (page + chunk) * TYPE2_PAGE_SIZE;
+	}
+	memset(buffer + readablePages * TYPE2_PAGE_SIZE, 0, (numPages - readablePages) * TYPE2_PAGE_SIZE);
+	*bytesRead = numPages * TYPE2_PAGE_SIZE;
+	return *bytesRead;
+}
+
+// MIFARE Classic: authenticate each sector once with the configured key
+int16_t PN5180ISO14443::readClassic(const ISO14443CardInfo *card, uint8_t *buffer, uint16_t bufferSize, uint16_t *bytesRead) {
+	uint16_t numBlocks = card->numBlocks;
+	if (numBlocks * 16 > bufferSize) numBlocks = bufferSize / 16;
+	// authentication uses the last 4 bytes of 7 byte UIDs
+	const uint8_t *authUid = card->uid + (card->uidLength - 4);
+
+	uint16_t block = 0;
+	while (block < numBlocks) {
+		// 32 sectors of 4 blocks, followed by sectors of 16 blocks (4K)
+		uint8_t sectorSize = (block < 128) ? 4 : 16;
+		if (mifareAuthenticate(block, classicKey, classicKeyType, authUid) != 0) {
+			PN5180DEBUG_PRINTF(F("*** ERROR: authentication of block %d failed!"), block);
+			PN5180DEBUG_PRINTLN();
+			return -2;
+		}
+		for (uint8_t i = 0; (i < sectorSize) && (block < numBlocks); i++, block++) {
+			if (!mifareBlockRead(block, buffer + block * 16)) {
+				return -2;
+			}
+			*bytesRead = (block + 1) * 16;
+		}
+	}
+	return *bytesRead;
 }
 
 bool PN5180ISO14443::mifareHalt() {
@@ -361,6 +1107,7 @@ bool PN5180ISO14443::mifareHalt() {
 	cmd[0] = 0x50;
 	cmd[1] = 0x00;
 	sendData(cmd, 2, 0x00);	
+	cardSelected = false;
 	return true;
 }
 
@@ -443,3 +1190,100 @@ bool PN5180ISO14443::isCardPresent() {
 	return ret;
 }
 
+bool PN5180ISO14443::updatePresence(bool present) {
+	if (cardPresent && !present) {
+		cardLeft = true;
+	}
+	cardPresent = present;
+	if (!present) {
+		cardSelected = false;
+	}
+	return present;
+}
+
+/*
+* Lightweight presence check for continuous polling.
+* The RF field and the transceive configuration are set up by the first
+* call (or after reset(), setRF_off() or another protocol) and stay up,
+* each call sends a single short command and waits for the SOF of the
+* answer with a short timeout:
+* - card selected by activateTypeA(): READ of the last block read as keep-alive,
+*   the card stays in ACTIVE state. A NAK (e.g. MIFARE Classic block not
+*   authenticated) still counts as present, but the card is IDLE afterwards.
+* - card in ISO14443-4 state after identifyCard(card, true): R(NAK) with
+*   block number 0, answered by R(ACK) within the frame waiting time. Only
+*   valid as long as no I-blocks were exchanged with the card.
+* - otherwise: WUPA, followed by HLTA if a card answered. The card is halted,
+*   use activateTypeA(buffer, 1) (WUPA) to select it afterwards. A halted
+*   card does not answer REQA, so isCardPresent() and readCardSerial() do
+*   not see it until the field is reset.
+* Returns within about 1ms in both cases.
+*/
+bool PN5180ISO14443::isCardPresentFast() {
+	PN5180DEBUG_PRINTLN(F("PN5180ISO14443::isCardPresentFast()"));
+	PN5180DEBUG_ENTER;
+
+	// skipped by the RF state tracking if the field is on with the Type A configuration
+	if (!setupRF()) {
+		PN5180DEBUG_EXIT;
+		return updatePresence(false);
+	}
+
+	// a reset or field ramp-up since activateTypeA() left the card IDLE
+	if (isCardSelected()) {
+		uint8_t cmd[2] = { TYPE2_CMD_READ, lastReadBlock };
+		uint8_t cmdLen = 2;
+		uint32_t timeoutUs = TYPEA_PRESENCE_TIMEOUT_US;
+		if (isoDep) {
+			// neither READ nor WUPA are answered in ISO14443-4 state
+			cmd[0] = ISODEP_R_NAK;
+			cmdLen = 1;
+			timeoutUs = isoDepFwtUs;
+		}
+		clearIRQStatus(RX_IRQ_STAT | RX_SOF_DET_IRQ_STAT | TX_IRQ_STAT | IDLE_IRQ_STAT | GENERAL_ERROR_IRQ_STAT);
+		if (sendData(cmd, cmdLen, 0x00) && waitForIRQ(RX_SOF_DET_IRQ_STAT | RX_IRQ_STAT, timeoutUs)) {
+			// a NAK is complete right after the SOF, data takes longer
+			if (!isoDep && waitForIRQ(RX_IRQ_STAT, TYPEA_SHORT_FRAME_US) && (rxBytesReceived() <= 1)) {
+				PN5180DEBUG_PRINTLN(F("NAK, card is IDLE now"));
+				cardSelected = false;
+			}
+			PN5180DEBUG_EXIT;
+			return updatePresence(true);
+		}
+		// card has left or lost its state, try to wake it up
+		cardSelected = false;
+	}
+
+	// OFF Crypto, clear RX and TX CRC for WUPA
+	writeRegisterWithAndMask(SYSTEM_CONFIG, 0xFFFFFFBF);
+	writeRegisterWithAndMask(CRC_RX_CONFIG, 0xFFFFFFFE);
+	writeRegisterWithAndMask(CRC_TX_CONFIG, 0xFFFFFFFE);
+
+	//Send WUPA, 7 bits in last byte
+	uint8_t wupa = 0x52;
+	clearIRQStatus(RX_IRQ_STAT | RX_SOF_DET_IRQ_STAT | TX_IRQ_STAT | IDLE_IRQ_STAT | GENERAL_ERROR_IRQ_STAT);
+	bool present = sendData(&wupa, 1, 0x07) && waitForIRQ(RX_SOF_DET_IRQ_STAT | RX_IRQ_STAT, TYPEA_PRESENCE_TIMEOUT_US);
+	if (present) {
+		// wait for the end of the ATQA, then halt the card (READY state
+		// would fall back to IDLE silently on the next WUPA)
+		waitForIRQ(RX_IRQ_STAT, TYPEA_SHORT_FRAME_US);
+		const uint8_t hlta[4] = { 0x50, 0x00, 0x57, 0xCD };
+		clearIRQStatus(TX_IRQ_STAT);
+		if (sendData(hlta, sizeof(hlta), 0x00)) {
+			waitForIRQ(TX_IRQ_STAT, TYPEA_HLTA_TIMEOUT_US);
+		}
+	}
+
+	PN5180DEBUG_EXIT;
+	return updatePresence(present);
+}
+
+/*
+* Returns true once after the card reported by isCardPresentFast() has
+* left the field.
+*/
+bool PN5180ISO14443::presenceChanged() {
+	bool ret = cardLeft;
+	cardLeft = false;
+	return ret;
+}
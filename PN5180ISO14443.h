@@ -21,6 +21,46 @@
 
 #include "PN5180.h"
 
+enum ISO14443WriteStatus {
+  ISO14443_WRITE_OK = 0,
+  ISO14443_WRITE_NAK = 1,
+  ISO14443_WRITE_TIMEOUT = 2,
+  ISO14443_WRITE_VERIFY_FAILED = 3,
+  ISO14443_WRITE_SKIPPED = 4
+};
+
+enum ISO14443CardType {
+  ISO14443_CARD_UNKNOWN = 0,
+  ISO14443_CARD_MIFARE_MINI,
+  ISO14443_CARD_MIFARE_CLASSIC_1K,
+  ISO14443_CARD_MIFARE_CLASSIC_4K,
+  ISO14443_CARD_MIFARE_ULTRALIGHT,      // Ultralight (no GET_VERSION)
+  ISO14443_CARD_MIFARE_ULTRALIGHT_C,    // Ultralight C (no GET_VERSION, 48 pages)
+  ISO14443_CARD_MIFARE_ULTRALIGHT_EV1,
+  ISO14443_CARD_NTAG,                   // NTAG21x
+  ISO14443_CARD_MIFARE_PLUS_2K,         // security level 2
+  ISO14443_CARD_MIFARE_PLUS_4K,         // security level 2
+  ISO14443_CARD_ISO_DEP                 // ISO14443-4, e.g. MIFARE DESFire
+};
+
+// Typed card descriptor returned by identifyCard()
+struct ISO14443CardInfo {
+  ISO14443CardType type;
+  const char *name;
+  uint8_t atqa[2];
+  uint8_t sak;
+  uint8_t uid[10];
+  uint8_t uidLength;
+  uint8_t version[8];        // GET_VERSION response, Type 2 tags only
+  uint8_t ats[16];           // ATS (optional), ISO-DEP cards only
+  uint8_t atsLength;
+  // memory layout
+  uint8_t blockSize;         // bytes per block (MIFARE) or page (Type 2)
+  uint16_t numBlocks;        // total number of blocks/pages
+  uint16_t firstUserBlock;
+  uint16_t numUserBlocks;
+};
+
 
 class PN5180ISO14443 : public PN5180 {
 
@@ -28,21 +68,67 @@ public:
   PN5180ISO14443(uint8_t SSpin, uint8_t BUSYpin, uint8_t RSTpin, SPIClass& spi=SPI);
   
 private:
+  bool cardSelected = false;    // card in ACTIVE state after activateTypeA()
+  uint16_t selectedSession = 0; // RF session of cardSelected, see getRFSession()
+  uint8_t selectedUid[7];       // UID of the selected card
+  uint8_t selectedUidLength = 0;
+  bool isoDep = false;          // selected card in ISO14443-4 state after RATS
+  uint32_t isoDepFwtUs = 0;     // frame waiting time from the ATS
+  bool type2FastRead = false;   // card answered GET_VERSION, FAST_READ supported
+  bool cardPresent = false;     // result of the last presence check
+  bool cardLeft = false;        // latched until presenceChanged() is called
+  uint8_t lastReadBlock = 0;    // keep-alive block for the presence check
+  bool updatePresence(bool present);
   uint16_t rxBytesReceived();
   uint32_t GetNumberOfBytesReceivedAndValidBits();
+  uint16_t transceiveTypeA(const uint8_t *cmd, uint8_t cmdLen, uint32_t timeoutUs);
+  uint8_t waitForAck(uint32_t timeoutUs);
+  uint8_t writeBlockNoRxCRC(uint8_t blockno, const uint8_t *data, uint8_t len);
+  uint8_t classicKey[6] = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
+  uint8_t classicKeyType = MIFARE_CLASSIC_KEYA;
+  // read strategies, see readAll()
+  typedef int16_t (PN5180ISO14443::*ReadStrategy)(const ISO14443CardInfo *card, uint8_t *buffer, uint16_t bufferSize,
+                                                  uint16_t *bytesRead);
+  struct ReadStrategyEntry {
+    ISO14443CardType type;
+    ReadStrategy read;
+  };
+  static const ReadStrategyEntry readStrategies[];
+  int16_t readType2Fast(const ISO14443CardInfo *card, uint8_t *buffer, uint16_t bufferSize, uint16_t *bytesRead);
+  int16_t readType2Compat(const ISO14443CardInfo *card, uint8_t *buffer, uint16_t bufferSize, uint16_t *bytesRead);
+  int16_t readClassic(const ISO14443CardInfo *card, uint8_t *buffer, uint16_t bufferSize, uint16_t *bytesRead);
 public:
   // Mifare TypeA
   int8_t activateTypeA(uint8_t *buffer, uint8_t kind);
+  int8_t reactivateTypeA(const uint8_t *uid, uint8_t uidLength, uint8_t *buffer);
+  // card selected by activateTypeA() or reactivateTypeA() in the current RF session
+  bool isCardSelected() { return cardSelected && (selectedSession == getRFSession()); }
+  uint8_t getSelectedUid(uint8_t *uid) { memcpy(uid, selectedUid, selectedUidLength); return selectedUidLength; }
   bool mifareBlockRead(uint8_t blockno,uint8_t *buffer);
   uint8_t mifareBlockWrite16(uint8_t blockno, const uint8_t *buffer);
   bool mifareHalt();
+  uint8_t writeBlocks(const uint8_t *blockNos, const uint8_t *data, uint8_t numBlocks, uint8_t blockSize, uint8_t *status, bool verify=false);
+  // NFC Forum Type 2 (MIFARE Ultralight, NTAG)
+  bool ntagGetVersion(uint8_t *version);
+  bool ntagFastRead(uint8_t startPage, uint8_t endPage, uint8_t *buffer);
+  bool type2ReadPages(uint8_t startPage, uint16_t numPages, uint8_t *buffer);
+  uint16_t type2NumPages(const uint8_t *version);
+  int16_t type2ReadMemory(uint8_t *buffer, uint16_t bufferSize);
+  // Card classification
+  int8_t identifyCard(ISO14443CardInfo *card, bool requestAts=false);
+  void setClassicKey(const uint8_t *key, uint8_t keyType);
+  int16_t readAll(const ISO14443CardInfo *card, uint8_t *buffer, uint16_t bufferSize, uint16_t *bytesRead=NULL);
   /*
    * Helper functions
    */
 public:   
   bool setupRF();
+  bool configureRF();
   int8_t readCardSerial(uint8_t *buffer);    
   bool isCardPresent();    
+  // halts an unselected card (HLTA), REQA based calls do not see it afterwards
+  bool isCardPresentFast();
+  bool presenceChanged();
 };
 
 #endif /* PN5180ISO14443_H */
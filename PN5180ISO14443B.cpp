@@ -0,0 +1,350 @@
+// NAME: PN5180ISO14443B.cpp
+//
+// DESC: ISO14443 Type B protocol on NXP Semiconductors PN5180 module for
+//       Arduino.
+//
+// This file is part of the PN5180 library for the Arduino environment.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+//#define DEBUG 1
+
+#include <Arduino.h>
+#include "PN5180ISO14443B.h"
+#include "Debug.h"
+
+// Type B commands
+#define TYPEB_CMD_REQB            (0x05)   // also APf of the slot markers
+#define TYPEB_CMD_ATTRIB          (0x1D)
+#define TYPEB_CMD_HLTB            (0x50)
+#define TYPEB_ATQB                (0x50)
+#define TYPEB_PARAM_WUPB          (0x08)
+
+// ATQB without CRC_B, the extended ATQB has one more protocol info byte
+#define TYPEB_ATQB_LEN            (12)
+// FWT of an ATQB (7680/fc = 566us) plus SOF
+#define TYPEB_ATQB_TIMEOUT_US     (800UL)
+// ~94us per character (10 etu) at 106 kbit/s, plus SOF and EOF
+#define TYPEB_FRAME_US(len)       (300UL + 100UL * (len))
+// answer to ATTRIB and HLTB, buffer size
+#define TYPEB_MAX_ANSWER_LEN      (64)
+// RX_STATUS: data integrity (CRC_B), protocol error, collision
+#define TYPEB_RX_ERROR_MASK       (0x00070000UL)
+
+// FSCI of the ATQB, maximum frame size in bytes
+static const uint16_t fscTable[9] = { 16, 24, 32, 40, 48, 64, 96, 128, 256 };
+
+PN5180ISO14443B::PN5180ISO14443B(uint8_t SSpin, uint8_t BUSYpin, uint8_t RSTpin, SPIClass& spi)
+              : PN5180(SSpin, BUSYpin, RSTpin, spi) {
+}
+
+/*
+ * Send a frame and wait for the answer, paced by RX_SOF_DET_IRQ and RX_IRQ.
+ * sofTimeoutUs: time from now until the SOF of the answer
+ * timeoutUs: time from the SOF until the end of the answer
+ * Returns ISO14443B_EC_NO_CARD if no SOF was detected, ISO14443B_EC_TIMEOUT
+ * if the reception did not end and ISO14443B_EC_PROTOCOL on a CRC_B or
+ * framing error, e.g. two cards answering in the same slot.
+ */
+ISO14443BErrorCode PN5180ISO14443B::transceiveB(const uint8_t *cmd, uint8_t cmdLen, uint8_t *answer, uint8_t maxLen, uint8_t *len,
+                                                uint32_t sofTimeoutUs, uint32_t timeoutUs) {
+  *len = 0;
+  clearIRQStatus(RX_IRQ_STAT | RX_SOF_DET_IRQ_STAT | TX_IRQ_STAT | IDLE_IRQ_STAT | GENERAL_ERROR_IRQ_STAT);
+  if (!sendData(cmd, cmdLen, 0x00)) {
+    return ISO14443B_EC_COMMAND_FAILED;
+  }
+  if (!waitForIRQ(RX_SOF_DET_IRQ_STAT | RX_IRQ_STAT, sofTimeoutUs)) {
+    return ISO14443B_EC_NO_CARD;
+  }
+  if (!waitForIRQ(RX_IRQ_STAT, timeoutUs)) {
+    return ISO14443B_EC_TIMEOUT;
+  }
+
+  uint32_t rxStatus;
+  if (!readRegister(RX_STATUS, &rxStatus)) {
+    return ISO14443B_EC_COMMAND_FAILED;
+  }
+  uint16_t rxLen = (uint16_t)(rxStatus & 0x000001ff);
+  if ((rxStatus & TYPEB_RX_ERROR_MASK) || (0 == rxLen) || (rxLen > maxLen)) {
+    PN5180DEBUG_PRINTF("*** Type B reception error, RX_STATUS=0x%lX", rxStatus);
+    PN5180DEBUG_PRINTLN();
+    return ISO14443B_EC_PROTOCOL;
+  }
+  if (!readData(rxLen, answer)) {
+    return ISO14443B_EC_COMMAND_FAILED;
+  }
+  *len = rxLen;
+  return ISO14443B_EC_OK;
+}
+
+/*
+ * ATQB: 0x50, PUPI (4), Application data (4), Protocol info (3 or 4), CRC_B
+ */
+bool PN5180ISO14443B::parseATQB(const uint8_t *atqb, uint8_t len, ISO14443BCard *card) {
+  if ((len < TYPEB_ATQB_LEN) || (TYPEB_ATQB != atqb[0])) {
+    return false;
+  }
+  memcpy(card->pupi, &atqb[1], 4);
+  memcpy(card->appData, &atqb[5], 4);
+  memcpy(card->protocolInfo, &atqb[9], 3);
+  uint8_t fsci = card->protocolInfo[1] >> 4;
+  card->maxFrameSize = fscTable[(fsci > 8) ? 8 : fsci];
+  uint8_t fwi = card->protocolInfo[2] >> 4;
+  if (15 == fwi) fwi = 4;              // RFU, use the default
+  card->fwtUs = 302UL << fwi;          // (256 * 16 / fc) * 2^FWI
+  return true;
+}
+
+/*
+ * REQB/WUPB, code=05
+ *
+ * Request format: APf (0x05), AFI, PARAM (WUPB flag, N), CRC_B
+ * Slot-MARKER format: APn ((n-1) << 4 | 0x05), CRC_B
+ *
+ * A card answers in slot 1 directly after REQB/WUPB or after the slot
+ * marker of the slot it has chosen. Each slot is closed as soon as it is
+ * known to be empty (no SOF within the ATQB waiting time).
+ */
+ISO14443BErrorCode PN5180ISO14443B::requestRound(uint8_t afi, uint8_t slotCode, bool wakeup, ISO14443BCard *cards, uint8_t maxCards,
+                                                 uint8_t *numCards) {
+  uint8_t slots = 1 << slotCode;
+  uint8_t collisions = 0;
+  uint8_t atqb[16];
+  uint8_t len;
+
+  for (uint8_t slot=1; (slot <= slots) && (*numCards < maxCards); slot++) {
+    ISO14443BErrorCode rc;
+    if (1 == slot) {
+      uint8_t req[3] = { TYPEB_CMD_REQB, afi, (uint8_t)((wakeup ? TYPEB_PARAM_WUPB : 0x00) | slotCode) };
+      rc = transceiveB(req, sizeof(req), atqb, sizeof(atqb), &len,
+                       TYPEB_FRAME_US(sizeof(req) + 2) + TYPEB_ATQB_TIMEOUT_US, TYPEB_FRAME_US(sizeof(atqb)));
+    }
+    else {
+      uint8_t marker = (uint8_t)(((slot - 1) << 4) | TYPEB_CMD_REQB);
+      rc = transceiveB(&marker, 1, atqb, sizeof(atqb), &len,
+                       TYPEB_FRAME_US(1 + 2) + TYPEB_ATQB_TIMEOUT_US, TYPEB_FRAME_US(sizeof(atqb)));
+    }
+
+    if (ISO14443B_EC_COMMAND_FAILED == rc) {
+      return rc;
+    }
+    if (ISO14443B_EC_NO_CARD == rc) {
+      continue;
+    }
+    ISO14443BCard card;
+    if ((ISO14443B_EC_OK != rc) || !parseATQB(atqb, len, &card)) {
+      PN5180DEBUG_PRINTF("slot=%d: collision", slot);
+      PN5180DEBUG_PRINTLN();
+      collisions++;
+      continue;
+    }
+    bool known = false;
+    for (uint8_t i=0; i<*numCards; i++) {
+      if (0 == memcmp(cards[i].pupi, card.pupi, 4)) known = true;
+    }
+    if (!known) {
+      cards[(*numCards)++] = card;
+    }
+  }
+
+  timings.slots = slots;
+  timings.collisions = collisions;
+  return (collisions > 0) ? ISO14443B_EC_COLLISION : ISO14443B_EC_OK;
+}
+
+/*
+ * Anticollision with slot markers.
+ * slots: 1, 2, 4, 8 or 16 slots in the first round, doubled for each
+ *        further round (upto ISO14443B_MAX_ROUNDS) while collisions remain
+ * wakeup: WUPB, i.e. halted cards answer too (first round only)
+ * The cards found are in READY-DECLARED state, see attrib() and haltB().
+ * Returns ISO14443B_EC_OK if all cards were resolved (or maxCards were
+ * found), ISO14443B_EC_COLLISION if collisions remain, numCards may be
+ * non-zero in this case.
+ */
+ISO14443BErrorCode PN5180ISO14443B::requestB(ISO14443BCard *cards, uint8_t maxCards, uint8_t *numCards, uint8_t slots,
+                                             bool wakeup, uint8_t afi) {
+  PN5180DEBUG_PRINTF("PN5180ISO14443B::requestB(maxCards=%d, slots=%d)", maxCards, slots);
+  PN5180DEBUG_PRINTLN();
+  PN5180DEBUG_ENTER;
+  unsigned long startTime = micros();
+  *numCards = 0;
+  timings.rounds = 0;
+
+  // REQB/WUPB and ATQB are always at 106 kbit/s
+  if (!setBitRate(ISO14443B_BR_106, ISO14443B_BR_106)) {
+    PN5180DEBUG_EXIT;
+    return ISO14443B_EC_COMMAND_FAILED;
+  }
+
+  uint8_t slotCode = 0;
+  while ((slotCode < 4) && ((1 << slotCode) < slots)) slotCode++;
+
+  ISO14443BErrorCode rc = ISO14443B_EC_OK;
+  while ((timings.rounds < ISO14443B_MAX_ROUNDS) && (*numCards < maxCards)) {
+    rc = requestRound(afi, slotCode, wakeup && (0 == timings.rounds), cards, maxCards, numCards);
+    timings.rounds++;
+    if (ISO14443B_EC_COLLISION != rc) break;
+    if (slotCode < 4) slotCode++;
+  }
+  if ((*numCards >= maxCards) && (ISO14443B_EC_COLLISION == rc)) {
+    rc = ISO14443B_EC_OK;
+  }
+  if ((ISO14443B_EC_OK == rc) && (0 == *numCards)) {
+    rc = ISO14443B_EC_NO_CARD;
+  }
+
+  timings.requestUs = micros() - startTime;
+  PN5180DEBUG_PRINTF("*** Found %d cards in %d rounds, %lu us", *numCards, timings.rounds, timings.requestUs);
+  PN5180DEBUG_PRINTLN();
+  PN5180DEBUG_EXIT;
+  return rc;
+}
+
+/*
+ * ATTRIB, code=1D
+ *
+ * Request format: 0x1D, PUPI (4), Param 1, Param 2, Param 3, Param 4, CRC_B
+ * Response format: MBLI/CID, CRC_B
+ *
+ * Selects the highest bit rates supported by the card (and the PN5180, upto
+ * maxBitRate) and a frame size of 256 bytes, then switches the RF
+ * configuration to these bit rates. cid is used only if the card supports it.
+ */
+ISO14443BErrorCode PN5180ISO14443B::attrib(const ISO14443BCard *card, uint8_t maxBitRate, uint8_t cid) {
+  PN5180DEBUG_PRINTF("PN5180ISO14443B::attrib(maxBitRate=%d, cid=%d)", maxBitRate, cid);
+  PN5180DEBUG_PRINTLN();
+  PN5180DEBUG_ENTER;
+  unsigned long startTime = micros();
+
+  // Protocol info byte 1: b1..b3 PCD to PICC 212/424/848, b5..b7 PICC to PCD,
+  // b8 same bit rate in both directions
+  uint8_t caps = card->protocolInfo[0];
+  uint8_t pcd = ISO14443B_BR_106, picc = ISO14443B_BR_106;
+  for (uint8_t br=ISO14443B_BR_212; br<=maxBitRate && br<=ISO14443B_BR_848; br++) {
+    bool toPicc = caps & (0x01 << (br - 1));
+    bool toPcd = caps & (0x10 << (br - 1));
+    if (caps & 0x80) {
+      if (toPicc && toPcd) pcd = picc = br;
+    }
+    else {
+      if (toPicc) pcd = br;
+      if (toPcd) picc = br;
+    }
+  }
+  if (!(card->protocolInfo[2] & 0x01)) cid = 0;   // CID not supported
+
+  uint8_t cmd[9];
+  cmd[0] = TYPEB_CMD_ATTRIB;
+  memcpy(&cmd[1], card->pupi, 4);
+  cmd[5] = 0x00;                                  // default TR0, TR1, SOF/EOF
+  cmd[6] = (uint8_t)((picc << 6) | (pcd << 4) | 0x08);   // FSDI 8: 256 bytes
+  cmd[7] = card->protocolInfo[1] & 0x0F;          // protocol type
+  cmd[8] = cid & 0x0F;
+
+  uint8_t answer[TYPEB_MAX_ANSWER_LEN];
+  uint8_t len;
+  ISO14443BErrorCode rc = transceiveB(cmd, sizeof(cmd), answer, sizeof(answer), &len,
+                                      TYPEB_FRAME_US(sizeof(cmd) + 2) + card->fwtUs, TYPEB_FRAME_US(sizeof(answer)));
+  if ((ISO14443B_EC_OK == rc) && ((answer[0] & 0x0F) != cmd[8])) {
+    rc = ISO14443B_EC_PROTOCOL;
+  }
+  // the new bit rates apply after the answer to ATTRIB
+  if ((ISO14443B_EC_OK == rc) && !setBitRate(pcd, picc)) {
+    rc = ISO14443B_EC_COMMAND_FAILED;
+  }
+
+  timings.attribUs = micros() - startTime;
+  PN5180DEBUG_PRINTF("*** ATTRIB rc=%d, %lu us", rc, timings.attribUs);
+  PN5180DEBUG_PRINTLN();
+  PN5180DEBUG_EXIT;
+  return rc;
+}
+
+/*
+ * HLTB, code=50
+ *
+ * Request format: 0x50, PUPI (4), CRC_B
+ * Response format: 0x00, CRC_B
+ */
+ISO14443BErrorCode PN5180ISO14443B::haltB(const ISO14443BCard *card) {
+  unsigned long startTime = micros();
+  uint8_t cmd[5];
+  cmd[0] = TYPEB_CMD_HLTB;
+  memcpy(&cmd[1], card->pupi, 4);
+
+  uint8_t answer[4];
+  uint8_t len;
+  ISO14443BErrorCode rc = transceiveB(cmd, sizeof(cmd), answer, sizeof(answer), &len,
+                                      TYPEB_FRAME_US(sizeof(cmd) + 2) + TYPEB_ATQB_TIMEOUT_US, TYPEB_FRAME_US(sizeof(answer)));
+  if ((ISO14443B_EC_OK == rc) && (0x00 != answer[0])) {
+    rc = ISO14443B_EC_PROTOCOL;
+  }
+  timings.haltUs = micros() - startTime;
+  return rc;
+}
+
+/*
+ * TX configuration 0x04..0x07 and RX configuration 0x84..0x87,
+ * ISO14443B at 106, 212, 424 and 848 kbit/s. loadRFConfig() skips an
+ * unchanged configuration.
+ */
+bool PN5180ISO14443B::setBitRate(uint8_t pcd, uint8_t picc) {
+  if (!loadRFConfig(0x04 + pcd, 0x84 + picc)) {
+    return false;
+  }
+  bitRatePcd = pcd;
+  bitRatePicc = picc;
+  return true;
+}
+
+bool PN5180ISO14443B::setupRF() {
+  if (!configureRF()) return false;
+
+  PN5180DEBUG(F("Turning ON RF field...\n"));
+  if (setRF_on()) {
+    PN5180DEBUG(F("done.\n"));
+  }
+  else return false;
+
+  return true;
+}
+
+/*
+ * Load the ISO14443B RF configuration (106 kbit/s) without switching the
+ * field, e.g. after another protocol used the PN5180 with the field kept on.
+ */
+bool PN5180ISO14443B::configureRF() {
+  PN5180DEBUG(F("Loading RF-Configuration...\n"));
+  if (loadRFConfig(0x04, 0x84)) {  // ISO14443B parameters, 106 kbit/s
+    PN5180DEBUG(F("done.\n"));
+  }
+  else return false;
+  bitRatePcd = bitRatePicc = ISO14443B_BR_106;
+
+  // OFF Crypto, CRC_B in both directions (may be changed by Type A commands)
+  writeRegisterWithAndMask(SYSTEM_CONFIG, 0xFFFFFFBF);
+  writeRegisterWithOrMask(CRC_RX_CONFIG, 0x00000001);
+  writeRegisterWithOrMask(CRC_TX_CONFIG, 0x00000001);
+  return true;
+}
+
+const char *PN5180ISO14443B::strerror(ISO14443BErrorCode code) {
+  switch (code) {
+    case ISO14443B_EC_OK: return ("OK!");
+    case ISO14443B_EC_NO_CARD: return ("No card detected!");
+    case ISO14443B_EC_COLLISION: return ("Unresolved collision!");
+    case ISO14443B_EC_TIMEOUT: return ("Reception timeout!");
+    case ISO14443B_EC_PROTOCOL: return ("Protocol or CRC error!");
+    case ISO14443B_EC_COMMAND_FAILED: return ("PN5180 command failed!");
+    default: return ("Undefined error code in ISO14443B!");
+  }
+}
@@ -0,0 +1,95 @@
+// NAME: PN5180ISO14443B.h
+//
+// DESC: ISO14443 Type B protocol on NXP Semiconductors PN5180 module for
+//       Arduino.
+//
+// This file is part of the PN5180 library for the Arduino environment.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+#ifndef PN5180ISO14443B_H
+#define PN5180ISO14443B_H
+
+#include "PN5180.h"
+
+enum ISO14443BErrorCode {
+  ISO14443B_EC_OK = 0,
+  ISO14443B_EC_NO_CARD = 1,
+  ISO14443B_EC_COLLISION = 2,        // unresolved collisions remain
+  ISO14443B_EC_TIMEOUT = 3,          // reception started but did not end
+  ISO14443B_EC_PROTOCOL = 4,         // malformed answer or CRC error
+  ISO14443B_EC_COMMAND_FAILED = 5    // host interface command failed
+};
+
+// Bit rates of ATTRIB, divisor of 106 kbit/s
+#define ISO14443B_BR_106  0
+#define ISO14443B_BR_212  1
+#define ISO14443B_BR_424  2
+#define ISO14443B_BR_848  3
+
+// anticollision rounds per requestB() call while collisions remain
+#ifndef ISO14443B_MAX_ROUNDS
+#define ISO14443B_MAX_ROUNDS 3
+#endif
+
+// One card answering REQB/WUPB
+struct ISO14443BCard {
+  uint8_t pupi[4];                   // pseudo-unique PICC identifier
+  uint8_t appData[4];
+  uint8_t protocolInfo[3];           // bit rates, frame size/protocol type, FWI/ADC/FO
+  uint16_t maxFrameSize;             // FSC in bytes
+  uint32_t fwtUs;                    // frame waiting time
+};
+
+// Timings of the last requestB(), attrib() and haltB()
+struct ISO14443BTimings {
+  unsigned long requestUs;           // REQB/WUPB including all slot markers
+  unsigned long attribUs;
+  unsigned long haltUs;
+  uint8_t rounds;
+  uint8_t slots;                     // slots of the last round
+  uint8_t collisions;                // colliding slots of the last round
+};
+
+class PN5180ISO14443B : public PN5180 {
+
+public:
+  PN5180ISO14443B(uint8_t SSpin, uint8_t BUSYpin, uint8_t RSTpin, SPIClass& spi=SPI);
+
+private:
+  uint8_t bitRatePcd = ISO14443B_BR_106;   // PCD to PICC, TX configuration
+  uint8_t bitRatePicc = ISO14443B_BR_106;  // PICC to PCD, RX configuration
+  ISO14443BTimings timings = { 0, 0, 0, 0, 0, 0 };
+  ISO14443BErrorCode transceiveB(const uint8_t *cmd, uint8_t cmdLen, uint8_t *answer, uint8_t maxLen, uint8_t *len,
+                                 uint32_t sofTimeoutUs, uint32_t timeoutUs);
+  ISO14443BErrorCode requestRound(uint8_t afi, uint8_t slotCode, bool wakeup, ISO14443BCard *cards, uint8_t maxCards,
+                                  uint8_t *numCards);
+  bool parseATQB(const uint8_t *atqb, uint8_t len, ISO14443BCard *card);
+  bool setBitRate(uint8_t pcd, uint8_t picc);
+
+public:
+  ISO14443BErrorCode requestB(ISO14443BCard *cards, uint8_t maxCards, uint8_t *numCards, uint8_t slots=4,
+                              bool wakeup=false, uint8_t afi=0x00);
+  ISO14443BErrorCode attrib(const ISO14443BCard *card, uint8_t maxBitRate=ISO14443B_BR_848, uint8_t cid=0);
+  ISO14443BErrorCode haltB(const ISO14443BCard *card);
+  uint8_t getBitRatePcd() { return bitRatePcd; }
+  uint8_t getBitRatePicc() { return bitRatePicc; }
+  const ISO14443BTimings *getTimings() { return &timings; }
+  /*
+   * Helper functions
+   */
+public:
+  bool setupRF();
+  bool configureRF();
+  const char *strerror(ISO14443BErrorCode code);
+};
+
+#endif /* PN5180ISO14443B_H */
@@ -22,6 +22,21 @@
 #include "PN5180ISO15693.h"
 #include "Debug.h"
 
+// ISO15693 timing, high data rate (26.48 kbit/s), single subcarrier
+#define ISO15693_BYTE_US          (302UL)    // 8 bits of 37.76us, VCD and VICC
+#define ISO15693_SOF_EOF_US       (302UL)    // VCD SOF+EOF, VICC SOF+EOF
+#define ISO15693_T1_US            (320UL)    // response delay t1 = 4352/fc
+#define ISO15693_T2_US            (310UL)    // min. delay response to next EOF t2 = 4192/fc
+#define ISO15693_WRITE_T1_US      (20000UL)  // max. response delay of write-alike commands
+#define ISO15693_MARGIN_US        (1000UL)   // host side polling
+// default response length if the caller does not know it
+#define ISO15693_DEFAULT_RESP_LEN (64)
+// size of the PN5180 reception/transmission buffer
+#define ISO15693_MAX_RESPONSE_LEN (508)
+#define ISO15693_MAX_REQUEST_LEN  (260)
+// RX_STATUS: data integrity, protocol error, collision
+#define ISO15693_RX_ERROR_MASK    (0x00070000UL)
+
 PN5180ISO15693::PN5180ISO15693(uint8_t SSpin, uint8_t BUSYpin, uint8_t RSTpin, SPIClass& spi) 
               : PN5180(SSpin, BUSYpin, RSTpin, spi) {
 }
@@ -34,10 +49,33 @@ PN5180ISO15693::PN5180ISO15693(uint8_t SSpin, uint8_t BUSYpin, uint8_t RSTpin, S
  *
  */
 ISO15693ErrorCode PN5180ISO15693::getInventory(uint8_t *uid) {
-  //                     Flags,  CMD, maskLen
-  uint8_t inventory[] = { 0x26, 0x01, 0x00 };
-  //                        |\- inventory flag + high data rate
-  //                        \-- 1 slot: only one card, no AFI field present
+  return getInventory(uid, 0L, 0, ISO15693_NO_AFI);
+}
+
+/*
+ * Inventory with 1 slot, only labels matching mask and AFI answer.
+ * mask: maskLen bits (0..64) compared against the UID starting at the LSB,
+ *       bytes LSB first like the UID. May be NULL if maskLen=0
+ * afi: application family identifier, ISO15693_NO_AFI = all labels
+ */
+ISO15693ErrorCode PN5180ISO15693::getInventory(uint8_t *uid, const uint8_t *mask, uint8_t maskLen, int16_t afi) {
+  //                       Flags,  CMD, [AFI,] maskLen, mask value (upto 8 bytes)
+  uint8_t inventory[12] = { 0x26, 0x01 };
+  //                          |\- inventory flag + high data rate
+  //                          \-- 1 slot: only one card, no AFI field present
+  uint8_t cmdLen = 2;
+  if (maskLen > 64) maskLen = 64;
+  if (ISO15693_NO_AFI != afi) {
+    inventory[0] |= 0x10; // AFI field present
+    inventory[cmdLen++] = uint8_t(afi);
+  }
+  inventory[cmdLen++] = maskLen;
+  for (uint8_t i=0; i<(maskLen+7)/8; i++) {
+    inventory[cmdLen++] = mask[i];
+  }
+  if (maskLen % 8) {
+    inventory[cmdLen-1] &= (1 << (maskLen % 8)) - 1;
+  }
   PN5180DEBUG(F("Get Inventory...\n"));
 
   for (int i=0; i<8; i++) {
@@ -45,7 +83,7 @@ ISO15693ErrorCode PN5180ISO15693::getInventory(uint8_t *uid) {
   }
   
   uint8_t *readBuffer;
-  ISO15693ErrorCode rc = issueISO15693Command(inventory, sizeof(inventory), &readBuffer);
+  ISO15693ErrorCode rc = issueISO15693Command(inventory, cmdLen, &readBuffer, 10);
   if (ISO15693_EC_OK != rc) {
     return rc;
   }
@@ -75,134 +113,790 @@ ISO15693ErrorCode PN5180ISO15693::getInventory(uint8_t *uid) {
  * Request format: SOF, Req.Flags, Inventory, AFI (opt.), Mask len, Mask value, CRC16, EOF
  * Response format: SOF, Resp.Flags, DSFID, UID, CRC16, EOF
  *
+ * Returns the UIDs packed into uid[8*maxTags], see inventory()
  */
 ISO15693ErrorCode PN5180ISO15693::getInventoryMultiple(uint8_t *uid, uint8_t maxTags, uint8_t *numCard) {
-  PN5180DEBUG_PRINTF("PN5180ISO15693::getInventoryMultiple(maxTags=%d, numCard=%d)", maxTags, *numCard);
+  PN5180DEBUG_PRINTF("PN5180ISO15693::getInventoryMultiple(maxTags=%d)", maxTags);
   PN5180DEBUG_PRINTLN();
   PN5180DEBUG_ENTER;
-  uint16_t collision[maxTags];
-  *numCard = 0;
-  uint8_t numCol = 0;
-  inventoryPoll(uid, maxTags, numCard, &numCol, collision);
-  PN5180DEBUG_PRINTF("*** Number of collisions=%d", numCol);
-  PN5180DEBUG_PRINTLN();
-
-  while(numCol){                                                 // 5+ Continue until no collisions detected
-#ifdef DEBUG
-    PN5180DEBUG(F("Polling with mask=0x"));
-    PN5180DEBUG(formatHex(collision[0]));
-    PN5180DEBUG_PRINTLN();
-#endif
-    inventoryPoll(uid, maxTags, numCard, &numCol, collision);
-    numCol--;
-    for(int i=0; i<numCol; i++){
-      collision[i] = collision[i+1];
+  ISO15693InventoryResult results[maxTags];
+  ISO15693ErrorCode rc = inventory(results, maxTags, numCard);
+  for (int i=0; i<*numCard; i++) {
+    for (int j=0; j<8; j++) {
+      uid[i*8+j] = results[i].uid[j];
     }
   }
   PN5180DEBUG_EXIT;
-  return ISO15693_EC_OK;
+  return rc;
+}
+
+/*
+ * Inventory of all labels in the field, 16 time slots per round.
+ *
+ * A collision in slot n of a round with mask M (len L) queues the mask
+ * n:M (len L+4), i.e. the next nibble of the UID. Pending masks are kept
+ * in a FIFO, up to the full 64 bit UID. The RF field stays on, labels
+ * are not reset between the rounds.
+ *
+ * Returns ISO15693_EC_OK, also if maxTags labels were found before all
+ * collisions could be resolved. ISO15693_EC_UNKNOWN_ERROR if collisions
+ * were left after 255 rounds, results holds the labels found until then.
+ */
+ISO15693ErrorCode PN5180ISO15693::inventory(ISO15693InventoryResult *results, uint8_t maxTags, uint8_t *numTags) {
+  return runInventory(results, maxTags, numTags, false, &estimator, 0L, 0, ISO15693_NO_AFI);
+}
+
+/*
+ * Inventory of the labels matching mask and AFI only, see getInventory().
+ * Non-matching labels stay silent and don't cause collisions.
+ */
+ISO15693ErrorCode PN5180ISO15693::inventory(ISO15693InventoryResult *results, uint8_t maxTags, uint8_t *numTags,
+                                            const uint8_t *mask, uint8_t maskLen, int16_t afi) {
+  return runInventory(results, maxTags, numTags, false, &estimator, mask, maskLen, afi);
+}
+
+/*
+ * Inventory like inventory(), but the number of slots per round is chosen
+ * from the estimated number of labels matching the mask:
+ *  - upto estimator.oneSlotMax labels: 1 slot round, a collision splits the
+ *    mask by one bit (binary tree)
+ *  - more labels: 16 slot round, a collision in slot n queues n:M (len L+4)
+ * The estimate of the root mask is the population seen by the previous
+ * inventories, so an empty field or a single label takes one short exchange.
+ * The estimate of a collided 16 slot mask follows Schoute (2.39 labels per
+ * collision slot), or the parent's estimate spread over its collisions.
+ */
+ISO15693ErrorCode PN5180ISO15693::inventoryAdaptive(ISO15693InventoryResult *results, uint8_t maxTags, uint8_t *numTags) {
+  return runInventory(results, maxTags, numTags, true, &estimator, 0L, 0, ISO15693_NO_AFI);
+}
+
+/*
+ * Adaptive inventory of the labels matching mask and AFI only. The
+ * population estimate is used as upper bound, but not updated.
+ */
+ISO15693ErrorCode PN5180ISO15693::inventoryAdaptive(ISO15693InventoryResult *results, uint8_t maxTags, uint8_t *numTags,
+                                                    const uint8_t *mask, uint8_t maskLen, int16_t afi) {
+  return runInventory(results, maxTags, numTags, true, &estimator, mask, maskLen, afi);
+}
+
+/*
+ * INVENTORY READ, custom code=A0 (FAST INVENTORY READ, custom code=A1)
+ *
+ * Request format: SOF, Req.Flags, InventoryRead, IC Mfg code (04), AFI (opt.), Mask len, Mask value,
+ *                 FirstBlockNumber, numBlocks-1, CRC16, EOF
+ * Response format (Option flag set): SOF, Resp.Flags, UID (part not in mask and slot number),
+ *                                    BlockData, CRC16, EOF
+ *
+ * Adaptive inventory, see inventoryAdaptive(), each label returns numBlock
+ * blocks starting at blockNo within its time slot. The data of results[i]
+ * is stored at blockData[i*numBlock*blockSize]. The UID is composed of the
+ * mask, the slot number and the returned part, rounded to full bytes.
+ * The DSFID is not returned, results[i].dsfid is 0.
+ * fast: FAST INVENTORY READ, response at 53 kbit/s.
+ *
+ * NXP ICODE labels only, others don't answer the custom command.
+ */
+ISO15693ErrorCode PN5180ISO15693::inventoryRead(ISO15693InventoryResult *results, uint8_t *blockData, uint8_t maxTags, uint8_t *numTags,
+                                                uint8_t blockNo, uint8_t numBlock, uint8_t blockSize, bool fast) {
+  *numTags = 0;
+  if ((0 == numBlock) || (uint16_t(blockNo) + numBlock > 256) ||
+      (9 + uint16_t(numBlock) * blockSize > ISO15693_MAX_RESPONSE_LEN)) {
+    return ISO15693_EC_BLOCK_NOT_AVAILABLE;
+  }
+  ISO15693InventoryRead read = { uint8_t(fast ? 0xA1 : 0xA0), blockNo, numBlock, blockSize, blockData };
+  return runInventory(results, maxTags, numTags, true, &estimator, 0L, 0, ISO15693_NO_AFI, &read);
 }
 
-ISO15693ErrorCode PN5180ISO15693::inventoryPoll(uint8_t *uid, uint8_t maxTags, uint8_t *numCard, uint8_t *numCol, uint16_t *collision){
-  PN5180DEBUG_PRINTF("PN5180ISO15693::inventoryPoll(maxTags=%d, numCard=%d, numCol=%d)", maxTags, *numCard, *numCol);
+ISO15693ErrorCode PN5180ISO15693::runInventory(ISO15693InventoryResult *results, uint8_t maxTags, uint8_t *numTags, bool adaptive,
+                                               ISO15693InventoryEstimator *est, const uint8_t *mask, uint8_t maskLen, int16_t afi, const ISO15693InventoryRead *read) {
+  PN5180DEBUG_PRINTF("PN5180ISO15693::runInventory(maxTags=%d, adaptive=%d, maskLen=%d, afi=%d)", maxTags, adaptive, maskLen, afi);
   PN5180DEBUG_PRINTLN();
   PN5180DEBUG_ENTER;
-  
-  uint8_t maskLen = 0;
-  if(*numCol > 0){
-    uint32_t mask = collision[0];
-    do{
-      mask >>= 4L;
-      maskLen++;
-    }while(mask > 0);
-  } 
-  uint8_t *p = (uint8_t*)&(collision[0]);
-  //                      Flags,  CMD,
-  const uint8_t inventory[7] = { 0x06, 0x01, uint8_t(maskLen*4), p[0], p[1], p[2], p[3] };
-  //                         |\- inventory flag + high data rate
-  //                         \-- 16 slots: upto 16 cards, no AFI field present
-  uint8_t cmdLen = 3 + (maskLen/2) + (maskLen%2);
-#ifdef DEBUG
-  PN5180DEBUG_PRINTF(F("mask=%d, maskLen=%d, cmdLen=%d"), p[0], maskLen, cmdLen);
+
+  if (maskLen > 64) maskLen = 64;
+  ISO15693InventoryMask queue[ISO15693_INVENTORY_QUEUE_SIZE];
+  uint8_t head = 0, count = 1;
+  queue[0].value = 0;
+  for (uint8_t i=0; i<(maskLen+7)/8; i++) {
+    queue[0].value |= (uint64_t)mask[i] << (8*i);
+  }
+  if (maskLen < 64) {
+    queue[0].value &= ((uint64_t)1 << maskLen) - 1;
+  }
+  queue[0].bits = maskLen;
+  queue[0].expected = est->population;
+  *numTags = 0;
+
+  est->oneSlotRounds = 0;
+  est->emptySlots = 0;
+  est->singleSlots = 0;
+  est->collisionSlots = 0;
+
+  uint8_t round = 0;
+  bool complete = true;
+  while ((count > 0) && (*numTags < maxTags)) {
+    ISO15693InventoryMask mask = queue[head];
+    head = (head + 1) % ISO15693_INVENTORY_QUEUE_SIZE;
+    count--;
+
+    uint8_t numSlots = 16;
+    if ((adaptive && (mask.expected <= est->oneSlotMax)) || (mask.bits > 60)) {
+      numSlots = 1;
+      est->oneSlotRounds++;
+    }
+
+    uint16_t collisionSlots;
+    uint8_t numResponses;
+    ISO15693ErrorCode rc = inventoryRound(&mask, afi, numSlots, round, results, maxTags, numTags, &collisionSlots, &numResponses, read);
+    if (ISO15693_EC_OK != rc) {
+      PN5180DEBUG_EXIT;
+      return rc;
+    }
+
+    uint8_t numCollisions = 0;
+    for (uint8_t slot=0; slot<16; slot++) {
+      if (collisionSlots & (1<<slot)) numCollisions++;
+    }
+    est->emptySlots += numSlots - numResponses - numCollisions;
+    est->singleSlots += numResponses;
+    est->collisionSlots += numCollisions;
+
+    uint8_t numChilds = (1 == numSlots) ? 2 : numCollisions;
+    if (0 == numCollisions) {
+      // resolved
+    }
+    else if ((mask.bits >= 64) || (numChilds > ISO15693_INVENTORY_QUEUE_SIZE - count)) {
+      // no room for the sub masks (or UID exhausted): repeat this mask later,
+      // labels already found are not recorded twice
+      queue[(head + count) % ISO15693_INVENTORY_QUEUE_SIZE] = mask;
+      count++;
+    }
+    else if (1 == numSlots) {
+      // binary split, next bit of the UID
+      float expected = ((mask.expected < 2.0f) ? 2.0f : mask.expected) / 2;
+      for (uint8_t bit=0; bit<2; bit++) {
+        ISO15693InventoryMask *next = &queue[(head + count) % ISO15693_INVENTORY_QUEUE_SIZE];
+        next->value = mask.value | ((uint64_t)bit << mask.bits);
+        next->bits = mask.bits + 1;
+        next->expected = expected;
+        count++;
+      }
+    }
+    else {
+      float expected = (mask.expected - numResponses) / numCollisions;
+      if (expected < 2.39f) expected = 2.39f;
+      for (uint8_t slot=0; slot<16; slot++) {
+        if (0 == (collisionSlots & (1<<slot))) continue;
+        ISO15693InventoryMask *next = &queue[(head + count) % ISO15693_INVENTORY_QUEUE_SIZE];
+        next->value = mask.value | ((uint64_t)slot << mask.bits);
+        next->bits = mask.bits + 4;
+        next->expected = expected;
+        count++;
+      }
+    }
+
+    if (round == 0xff) {
+      PN5180DEBUG(F("*** Inventory aborted, too many rounds\n"));
+      complete = false;
+      break;
+    }
+    round++;
+  }
+  est->rounds = round;
+
+  if ((0 != maskLen) || (ISO15693_NO_AFI != afi)) {
+    // subset of the field only
+  }
+  else if (complete && (count == 0)) { // exact population, not cut by maxTags
+    est->population = est->smoothing * (*numTags) + (1.0f - est->smoothing) * est->population;
+  }
+  else if (est->population < *numTags) {
+    est->population = *numTags;
+  }
+
+  PN5180DEBUG_PRINTF("*** Found %d labels in %d rounds", *numTags, round);
   PN5180DEBUG_PRINTLN();
-#endif
-  clearIRQStatus(0x000FFFFF);                                      // 3. Clear all IRQ_STATUS flags
-  sendData(inventory, cmdLen, 0);                                  // 4. 5. 6. Idle/StopCom Command, Transceive Command, Inventory command
-  
-  for(uint8_t slot=0; slot<16; slot++){                                // 7. Loop to check 16 time slots for data
-    uint32_t rxStatus;
-    uint32_t irqStatus = getIRQStatus();
-    readRegister(RX_STATUS, &rxStatus);
-    PN5180DEBUG(F("slot="));
-    PN5180DEBUG(formatHex(slot));
-    PN5180DEBUG(F(": "));
-    PN5180DEBUG(F("irqStatus="));
-    PN5180DEBUG(formatHex(irqStatus));
-    PN5180DEBUG(F(", RX_STATUS="));
-    PN5180DEBUG(formatHex(rxStatus));
-    PN5180DEBUG(F(": "));
-    uint16_t len = (uint16_t)(rxStatus & 0x000001ff);
-    if((rxStatus >> 18) & 0x01 && *numCol < maxTags){              // 7+ Determine if a collision occurred
-      if(maskLen > 0) collision[*numCol] = collision[0] | (slot << (maskLen * 2));
-      else collision[*numCol] = slot << (maskLen * 2); // Yes, store position of collision
-      *numCol = *numCol + 1;
+  PN5180DEBUG_EXIT;
+  return complete ? ISO15693_EC_OK : ISO15693_EC_UNKNOWN_ERROR;
+}
+
+/*
+ * One inventory round with 1 or 16 time slots for the given mask.
+ * Labels are appended to results (skipping UIDs already found), slots
+ * with a collision or a corrupted response are flagged in collisionSlots,
+ * numResponses counts the slots with a valid response. An error response
+ * without RX errors (INVENTORY READ of a block the label does not have)
+ * is one label too, it is counted but not recorded.
+ *
+ * Each slot is closed by an EOF-only frame as soon as the response has
+ * been received (but not before t2 after its end) or no SOF was detected
+ * within t1. TX_CONFIG is restored afterwards instead of switching the RF
+ * field off and on.
+ *
+ * With read, the round is an INVENTORY READ, see inventoryRead().
+ */
+ISO15693ErrorCode PN5180ISO15693::inventoryRound(const ISO15693InventoryMask *mask, int16_t afi, uint8_t numSlots, uint8_t round,
+                                                 ISO15693InventoryResult *results, uint8_t maxTags, uint8_t *numTags,
+                                                 uint16_t *collisionSlots, uint8_t *numResponses, const ISO15693InventoryRead *read) {
 #ifdef DEBUG
-      PN5180DEBUG_PRINTF("Collision detected for UIDs matching %X starting at LSB", collision[*numCol-1]);
-      PN5180DEBUG_PRINTLN();
+  PN5180DEBUG_PRINTF("PN5180ISO15693::inventoryRound(maskLen=%d, numSlots=%d, round=%d)", mask->bits, numSlots, round);
+  PN5180DEBUG_PRINTLN();
 #endif
+  PN5180DEBUG_ENTER;
+
+  //                       Flags,  CMD, [mfg,] [AFI,] maskLen, mask value (upto 8 bytes), [1stBlock, blocksToRead]
+  uint8_t inventory[16] = { 0x06, 0x01 };
+  //                          |\- inventory flag + high data rate
+  //                          \-- 16 slots, no AFI field present
+  uint8_t cmdLen = 2;
+  if (1 == numSlots) inventory[0] |= 0x20; // 1 slot
+  if (read) {
+    inventory[0] |= 0x40; // option flag: UID in response
+    inventory[1] = read->cmd;
+    inventory[cmdLen++] = 0x04; // NXP
+  }
+  if (ISO15693_NO_AFI != afi) {
+    inventory[0] |= 0x10; // AFI field present
+    inventory[cmdLen++] = uint8_t(afi);
+  }
+  inventory[cmdLen++] = mask->bits;
+  for (uint8_t i=0; i<(mask->bits + 7) / 8; i++) {
+    inventory[cmdLen++] = uint8_t(mask->value >> (8*i));
+  }
+  // response: flags, DSFID, UID or flags, UID bytes not covered by mask and slot number, data
+  uint8_t knownBytes = 0;
+  uint16_t respLen = 10;
+  uint16_t dataLen = 0;
+  if (read) {
+    inventory[cmdLen++] = read->blockNo;
+    inventory[cmdLen++] = uint8_t(read->numBlock-1);
+    knownBytes = (mask->bits + ((numSlots > 1) ? 4 : 0)) / 8;
+    dataLen = read->numBlock * read->blockSize;
+    respLen = 1 + (8 - knownBytes) + dataLen;
+  }
+  *collisionSlots = 0;
+  *numResponses = 0;
+
+  bool fastRx = (read && (0xA1 == read->cmd));
+  setFastRx(fastRx);
+  uint32_t txConfig;
+  if (!readRegister(TX_CONFIG, &txConfig)) {
+    PN5180DEBUG_EXIT;
+    return ISO15693_EC_UNKNOWN_ERROR;
+  }
+
+  unsigned long rxEnd = 0;
+  bool received = false;
+  for (uint8_t slot=0; slot<numSlots; slot++) {
+    uint32_t sofTimeoutUs = ISO15693_SOF_EOF_US + ISO15693_T1_US + ISO15693_MARGIN_US;
+    clearIRQStatus(RX_SOF_DET_IRQ_STAT | IDLE_IRQ_STAT | TX_IRQ_STAT | RX_IRQ_STAT);
+    if (0 == slot) {
+      sofTimeoutUs += (cmdLen + 2) * ISO15693_BYTE_US;
+      sendData(inventory, cmdLen);                               // request
     }
-    else if(!(irqStatus & RX_IRQ_STAT) && !len){                   // 8. Check if a card has responded
-      PN5180DEBUG(F("No card in this time slot."));
+    else {
+      // fast hosts are done with the last response before t2 has passed
+      if (received) while ((micros() - rxEnd) < ISO15693_T2_US);
+      sendData(inventory, 0);                                    // EOF only
+    }
+
+    uint32_t rxStatus;
+    ISO15693ErrorCode slotRc = waitForResponse(sofTimeoutUs, sofTimeoutUs + (respLen + 3) * ISO15693_BYTE_US, &rxStatus);
+    rxEnd = micros();
+    received = (EC_NO_CARD != slotRc);
+    if (EC_NO_CARD == slotRc) {
+      PN5180DEBUG_PRINTF("slot=%d: empty", slot);
       PN5180DEBUG_PRINTLN();
     }
-    else{
-#ifdef DEBUG
-      PN5180DEBUG_PRINTF("slot=%d, irqStatus: %ld, RX_STATUS: %ld, Response length=%d", slot, irqStatus, rxStatus, len);
-#endif
-      uint8_t *readBuffer;
-      readBuffer = readData(len+1);                                // 9. Read reception buffer
-      if(0L == readBuffer){
-        PN5180DEBUG(F("ERROR in readData!"));
+    else {
+      uint16_t len = (uint16_t)(rxStatus & 0x000001ff);
+      uint8_t *readBuffer = 0L;
+      if ((ISO15693_EC_OK == slotRc) && ((respLen == len) || (2 == len)) && (0 == (rxStatus & ISO15693_RX_ERROR_MASK))) {
+        readBuffer = readData(len);
+      }
+      if (readBuffer && (2 == len) && (readBuffer[0] & 0x01)) {
+        // clean error response of one label, e.g. block not available
+        PN5180DEBUG_PRINTF("slot=%d: error response 0x%02X", slot, readBuffer[1]);
         PN5180DEBUG_PRINTLN();
-		PN5180DEBUG_EXIT;
-        return ISO15693_EC_UNKNOWN_ERROR;
+        *numResponses = *numResponses + 1;
       }
-#ifdef DEBUG
-      PN5180DEBUG(F("readBuffer="));
-      for(int i=0; i<len+1; i++){
-        PN5180DEBUG(formatHex(readBuffer[i]));
-        if (i<len-2) PN5180DEBUG(" ");
+      else if ((0L == readBuffer) || (respLen != len) || (readBuffer[0] & 0x01)) {
+        PN5180DEBUG_PRINTF("slot=%d: collision, RX_STATUS=0x%lX", slot, rxStatus);
+        PN5180DEBUG_PRINTLN();
+        *collisionSlots |= (1<<slot);
       }
-      PN5180DEBUG_PRINTLN();
+      else {
+        *numResponses = *numResponses + 1;
+        uint8_t uid[8];
+        uint8_t dsfid = 0;
+        if (read) {
+          uint64_t known = mask->value;
+          if (numSlots > 1) known |= (uint64_t)slot << mask->bits;
+          for (uint8_t i=0; i<8; i++) {
+            uid[i] = (i < knownBytes) ? uint8_t(known >> (8*i)) : readBuffer[1 + i - knownBytes];
+          }
+        }
+        else {
+          dsfid = readBuffer[1];
+          memcpy(uid, &readBuffer[2], 8);
+        }
+        bool known = false;
+        for (uint8_t i=0; (i<*numTags) && !known; i++) {
+          known = (0 == memcmp(results[i].uid, uid, 8));
+        }
+        if (!known && (*numTags < maxTags)) {
+          ISO15693InventoryResult *r = &results[*numTags];
+          memcpy(r->uid, uid, 8);
+          r->dsfid = dsfid;
+          r->slot = slot;
+          r->round = round;
+          if (read) {
+            memcpy(&read->data[*numTags * dataLen], &readBuffer[len - dataLen], dataLen);
+          }
+          *numTags = *numTags + 1;
+        }
+#ifdef DEBUG
+        PN5180DEBUG_PRINTF("slot=%d: DSFID=0x%X, UID=", slot, dsfid);
+        for (int i=0; i<8; i++) {
+          PN5180DEBUG(formatHex(uid[7-i]));
+        }
+        PN5180DEBUG(known ? F(" (known)") : F(""));
+        PN5180DEBUG_PRINTLN();
 #endif
-
-      // Record raw UID data                                       // 10. Record all data to Inventory struct
-      for (int i=0; i<8; i++) {
-        uint8_t startAddr = (*numCard * 8) + i;
-        uid[startAddr] = readBuffer[2+i];
       }
-      *numCard = *numCard + 1;
+    }
 
-#ifdef DEBUG
-      PN5180DEBUG_PRINTF("getInventoryMultiple: Response flags: 0x%X, Data Storage Format ID: 0x%X", readBuffer[0], readBuffer[1]);
-      PN5180DEBUG_PRINTLN();
-      PN5180DEBUG_PRINTF("numCard=%d\n", *numCard);
-      PN5180DEBUG_PRINTLN();
-#endif
+    if ((slot == 0) && (numSlots > 1)) {
+      writeRegisterWithAndMask(TX_CONFIG, 0xFFFFFB3F);           // Next SEND_DATA will only include EOF
     }
-    
-    if(slot+1 < 16){ // If we have more cards to poll for...
-      writeRegisterWithAndMask(TX_CONFIG, 0xFFFFFB3F);             // 11. Next SEND_DATA will only include EOF
-      clearIRQStatus(0x000FFFFF);                                  // 14. Clear all IRQ_STATUS flags
-      sendData(inventory, 0, 0);                                   // 12. 13. 15. Idle/StopCom Command, Transceive Command, Send EOF
+  }
+
+  if (numSlots > 1) {
+    writeRegister(TX_CONFIG, txConfig);                          // restore full frames
+  }
+  clearIRQStatus(RX_SOF_DET_IRQ_STAT | IDLE_IRQ_STAT | TX_IRQ_STAT | RX_IRQ_STAT);
+  PN5180DEBUG_EXIT;
+  return ISO15693_EC_OK;
+}
+
+/*
+ * Request header: flags, command code and the UID (addressed mode), or only
+ * flags with the Select flag and command code if uid is the label selected
+ * by selectTag(), saving 8 bytes (2.4ms at 26 kbit/s) per request.
+ * Returns the header length, 2 or 10.
+ */
+uint8_t PN5180ISO15693::requestHeader(uint8_t *frame, uint8_t cmd, const uint8_t *uid) {
+  frame[1] = cmd;
+  if (isTagSelected() && (0 == memcmp(uid, selectedUid, 8))) {
+    frame[0] = 0x12; // select flag + high data rate
+    return 2;
+  }
+  frame[0] = 0x22; // address flag + high data rate
+  for (int i=0; i<8; i++) {
+    frame[2+i] = uid[i];
+  }
+  return 10;
+}
+
+/*
+ * Request header of custom commands: like requestHeader(), followed by the
+ * IC manufacturer code, taken from the UID (0x04 for NXP).
+ * Returns the header length, 3 or 11.
+ */
+uint8_t PN5180ISO15693::customHeader(uint8_t *frame, uint8_t cmd, const uint8_t *uid) {
+  uint8_t len = requestHeader(frame, cmd, uid);
+  for (uint8_t i=len; i>2; i--) {
+    frame[i] = frame[i-1];
+  }
+  frame[2] = uid[6];
+  return len + 1;
+}
+
+/*
+ * Select, code=25
+ *
+ * Request format: SOF, Req.Flags, Select, UID, CRC16, EOF
+ * Response format: SOF, Resp.Flags, CRC16, EOF
+ *
+ * Starts a session: the label enters the selected state, following commands
+ * for this UID are sent with the Select flag and without the UID. Another
+ * selected label returns to the ready state. End with deselectTag(). The
+ * session also ends if a selected request is not answered (EC_NO_CARD),
+ * track() reports the label as departed, or the field was off or the
+ * PN5180 reset in between (through any instance, see getRFSession()).
+ */
+ISO15693ErrorCode PN5180ISO15693::selectTag(const uint8_t *uid) {
+  //                  flags, cmd, uid
+  uint8_t select[] = { 0x22, 0x25, 1,2,3,4,5,6,7,8 }; // UID has LSB first!
+  for (int i=0; i<8; i++) {
+    select[2+i] = uid[i];
+  }
+  PN5180DEBUG(F("Select...\n"));
+
+  tagSelected = false;
+  uint8_t *readBuffer;
+  ISO15693ErrorCode rc = issueISO15693Command(select, sizeof(select), &readBuffer, 1);
+  if (ISO15693_EC_OK != rc) {
+    return rc;
+  }
+  memcpy(selectedUid, uid, 8);
+  selectedSession = getRFSession();
+  tagSelected = true;
+  return ISO15693_EC_OK;
+}
+
+/*
+ * Ends the session of selectTag() with RESET TO READY (Select flag, no UID),
+ * the label returns to the ready state.
+ */
+ISO15693ErrorCode PN5180ISO15693::deselectTag() {
+  if (!isTagSelected()) {
+    tagSelected = false;
+    return ISO15693_EC_OK;
+  }
+  //                        flags, cmd
+  uint8_t resetToReady[] = { 0x12, 0x26 };
+  //                           |\- high data rate
+  //                           \-- select flag, no UID
+  PN5180DEBUG(F("Deselect...\n"));
+  tagSelected = false;
+  uint8_t *readBuffer;
+  return issueISO15693Command(resetToReady, sizeof(resetToReady), &readBuffer, 1);
+}
+
+/*
+ * Stay quiet, code=02
+ *
+ * Request format: SOF, Req.Flags, StayQuiet, UID, CRC16, EOF
+ * Response format: no response
+ *
+ * The label stays silent on non-addressed and inventory requests until
+ * it is reset (RESET TO READY, SELECT or the RF field going off).
+ */
+ISO15693ErrorCode PN5180ISO15693::stayQuiet(const uint8_t *uid) {
+  //                     flags, cmd, uid
+  uint8_t stayQuiet[] = { 0x22, 0x02, 1,2,3,4,5,6,7,8 }; // UID has LSB first!
+  for (int i=0; i<8; i++) {
+    stayQuiet[2+i] = uid[i];
+  }
+  if (tagSelected && (0 == memcmp(uid, selectedUid, 8))) tagSelected = false;
+  PN5180DEBUG(F("Stay quiet...\n"));
+
+  clearIRQStatus(TX_IRQ_STAT | RX_SOF_DET_IRQ_STAT | RX_IRQ_STAT);
+  if (!sendData(stayQuiet, sizeof(stayQuiet))) {
+    return ISO15693_EC_UNKNOWN_ERROR;
+  }
+  uint32_t txTimeUs = (sizeof(stayQuiet) + 2) * ISO15693_BYTE_US + ISO15693_SOF_EOF_US + ISO15693_MARGIN_US;
+  if (!waitForIRQ(TX_IRQ_STAT, txTimeUs)) {
+    return ISO15693_EC_UNKNOWN_ERROR;
+  }
+  return ISO15693_EC_OK;
+}
+
+/*
+ * Reset to ready, code=26
+ *
+ * Request format: SOF, Req.Flags, ResetToReady, UID, CRC16, EOF
+ * Response format: SOF, Resp.Flags, CRC16, EOF
+ *
+ * Returns EC_NO_CARD if the label did not answer.
+ */
+ISO15693ErrorCode PN5180ISO15693::resetToReady(const uint8_t *uid) {
+  //                        flags, cmd, uid
+  uint8_t resetToReady[] = { 0x22, 0x26, 1,2,3,4,5,6,7,8 }; // UID has LSB first!
+  for (int i=0; i<8; i++) {
+    resetToReady[2+i] = uid[i];
+  }
+  if (tagSelected && (0 == memcmp(uid, selectedUid, 8))) tagSelected = false;
+  PN5180DEBUG(F("Reset to ready...\n"));
+
+  uint8_t *readBuffer;
+  return issueISO15693Command(resetToReady, sizeof(resetToReady), &readBuffer, 1);
+}
+
+/*
+ * Continuous tracking of the labels in the field.
+ * tags: table of maxTags entries, owned by the caller
+ * callback: called on each arrival and departure, may be NULL
+ * probeIntervalMs: period of the departure probes
+ *
+ * Call track() from loop(). Each new label is put to quiet state, so the
+ * following inventories only see newcomers and their cost follows the
+ * arrival rate, not the number of labels in the field. The RF field has to
+ * stay on while tracking, as switching it off resets all quiet labels.
+ */
+void PN5180ISO15693::beginTracking(ISO15693TrackedTag *tags, uint8_t maxTags, ISO15693TrackCallback callback, unsigned long probeIntervalMs) {
+  trackedTags = tags;
+  maxTracked = maxTags;
+  numTracked = 0;
+  trackCallback = callback;
+  probeInterval = probeIntervalMs;
+  lastProbe = millis();
+}
+
+void PN5180ISO15693::endTracking() {
+  trackedTags = 0L;
+  maxTracked = 0;
+  numTracked = 0;
+  trackCallback = 0L;
+}
+
+/*
+ * One tracking step:
+ *  1. inventory, only labels not in quiet state answer
+ *  2. new labels: record, STAY QUIET, arrival event; labels already known
+ *     (reset in between, e.g. by a short field gap) are put to quiet again
+ *  3. every probeInterval: addressed RESET TO READY to each tracked label,
+ *     ISO15693_TRACK_MISSES probes in a row without answer = departure
+ *     event, otherwise STAY QUIET again
+ * The inventories of track() only count newcomers, they use an estimator of
+ * their own and do not disturb the one of inventoryAdaptive().
+ */
+ISO15693ErrorCode PN5180ISO15693::track() {
+  PN5180DEBUG_PRINTF("PN5180ISO15693::track(numTracked=%d)", numTracked);
+  PN5180DEBUG_PRINTLN();
+  PN5180DEBUG_ENTER;
+  if (0L == trackedTags) {
+    PN5180DEBUG_EXIT;
+    return ISO15693_EC_UNKNOWN_ERROR;
+  }
+
+  ISO15693InventoryResult results[ISO15693_TRACK_BATCH];
+  uint8_t numTags = 0;
+  ISO15693ErrorCode rc = runInventory(results, ISO15693_TRACK_BATCH, &numTags, true, &trackEstimator, 0L, 0, ISO15693_NO_AFI);
+  if (ISO15693_EC_OK != rc) {
+    PN5180DEBUG_EXIT;
+    return rc;
+  }
+
+  unsigned long now = millis();
+  for (uint8_t i=0; i<numTags; i++) {
+    uint8_t index = 0;
+    while ((index < numTracked) && (0 != memcmp(trackedTags[index].uid, results[i].uid, 8))) {
+      index++;
+    }
+    if (index == numTracked) { // new label
+      if (numTracked >= maxTracked) {
+        PN5180DEBUG(F("*** Tracking table full\n"));
+        stayQuiet(results[i].uid);   // untracked, but must not answer each inventory
+        continue;
+      }
+      memcpy(trackedTags[index].uid, results[i].uid, 8);
+      trackedTags[index].arrived = now;
+      trackedTags[index].misses = 0;
+      numTracked++;
+      if (trackCallback) trackCallback(&trackedTags[index], true, now);
+      if (commissionTemplate) {
+        ISO15693CommissionResult result;
+        commissionTag(results[i].uid, results[i].dsfid, commissionTemplate, &result);
+        if (result.skipped) commissionStats.skipped++;
+        else if (ISO15693_EC_OK == result.rc) commissionStats.commissioned++;
+        else commissionStats.failed++;
+        if (commissionCallback) commissionCallback(&result);
+      }
+    }
+    trackedTags[index].lastSeen = now;
+    trackedTags[index].misses = 0;
+    stayQuiet(results[i].uid);
+  }
+
+  if ((now - lastProbe) >= probeInterval) {
+    lastProbe = now;
+    uint8_t index = 0;
+    while (index < numTracked) {
+      if (EC_NO_CARD == resetToReady(trackedTags[index].uid)) {
+        if (++trackedTags[index].misses >= ISO15693_TRACK_MISSES) {
+          trackDeparture(index, millis());
+          continue; // table entry was replaced by the last one
+        }
+        index++;
+        continue;
+      }
+      trackedTags[index].lastSeen = millis();
+      trackedTags[index].misses = 0;
+      stayQuiet(trackedTags[index].uid);
+      index++;
     }
   }
-  setRF_off();                                                     // 16. Switch off RF field
-  setupRF();                                                       // 1. 2. Load ISO15693 config, RF on
+
   PN5180DEBUG_EXIT;
   return ISO15693_EC_OK;
 }
 
+void PN5180ISO15693::trackDeparture(uint8_t index, unsigned long now) {
+  ISO15693TrackedTag tag = trackedTags[index];
+  invalidateCache(tag.uid);
+  if (tagSelected && (0 == memcmp(tag.uid, selectedUid, 8))) tagSelected = false;
+  numTracked--;
+  trackedTags[index] = trackedTags[numTracked];
+  if (trackCallback) trackCallback(&tag, false, now);
+}
+
+/*
+ * Commission each label arriving in track() with tpl, see commissionTag().
+ * Tracking must be started with beginTracking(). callback is called with
+ * the result of each label, may be NULL. tpl must stay valid until
+ * endCommissioning(). Labels set to privacy mode are reported as departed
+ * at the next probe of track().
+ */
+void PN5180ISO15693::beginCommissioning(const ISO15693CommissionTemplate *tpl, ISO15693CommissionCallback callback) {
+  commissionTemplate = tpl;
+  commissionCallback = callback;
+  commissionStats.commissioned = 0;
+  commissionStats.skipped = 0;
+  commissionStats.failed = 0;
+  commissionStats.startTime = millis();
+  commissionStats.tagsPerMinute = 0.0f;
+}
+
+void PN5180ISO15693::endCommissioning() {
+  commissionTemplate = 0L;
+  commissionCallback = 0L;
+}
+
+const ISO15693CommissionStats *PN5180ISO15693::getCommissionStats() {
+  unsigned long elapsed = millis() - commissionStats.startTime;
+  if (elapsed > 0) {
+    commissionStats.tagsPerMinute = float(commissionStats.commissioned) * 60000.0f / elapsed;
+  }
+  return &commissionStats;
+}
+
+/*
+ * Apply tpl to the label uid, dsfid as reported by the inventory.
+ *
+ * Commissioned labels are recognized by a marker written after all other
+ * settings, so an interrupted commissioning is repeated:
+ *  - tpl->dsfid >= 0: a label with this DSFID is skipped without any RF exchange
+ *  - else tpl->afi: a label with this AFI is skipped (cached GET SYSTEM
+ *    INFORMATION), the AFI is written last
+ *  - neither: each arrival is commissioned again
+ * The steps are run in a session (selectTag(), no UID in the requests):
+ *  - memory image with updateTagMemory(), changed blocks only, then LOCK BLOCK
+ *    for the image blocks not locked yet (one GET MULTIPLE BLOCK SECURITY STATUS)
+ *  - WRITE AFI if it differs (cached GET SYSTEM INFORMATION), LOCK AFI
+ *  - one GET RANDOM NUMBER for all passwords: SET PASSWORD with the current
+ *    password of each identifier (factory defaults 00000000 for write,
+ *    0F0F0F0F for privacy if NULL), WRITE PASSWORD, LOCK PASSWORD
+ *  - WRITE DSFID, LOCK DSFID
+ *  - ENABLE PRIVACY, after the session
+ * The first failing step ends the commissioning, result->rc is returned.
+ */
+ISO15693ErrorCode PN5180ISO15693::commissionTag(const uint8_t *uid, uint8_t dsfid, const ISO15693CommissionTemplate *tpl,
+                                                ISO15693CommissionResult *result) {
+  PN5180DEBUG_ENTER;
+  static const uint8_t defaultWritePassword[4] = { 0x00, 0x00, 0x00, 0x00 };
+  static const uint8_t defaultPrivacyPassword[4] = { 0x0F, 0x0F, 0x0F, 0x0F };
+  unsigned long startTime = micros();
+  memset(result, 0, sizeof(*result));
+  memcpy(result->uid, uid, 8);
+  bool afiMarker = (tpl->dsfid < 0) && (ISO15693_NO_AFI != tpl->afi);
+  bool commissioned = (tpl->dsfid >= 0) && (dsfid == uint8_t(tpl->dsfid));
+  if (afiMarker) {
+    ISO15693SystemInfo info;
+    commissioned = (ISO15693_EC_OK == getSystemInfo(uid, &info)) && (info.infoFlags & 0x02) &&
+                   (info.afi == uint8_t(tpl->afi));
+  }
+  if (commissioned) {
+    PN5180DEBUG(F("*** Already commissioned\n"));
+    result->skipped = true;
+    result->rc = ISO15693_EC_OK;
+    PN5180DEBUG_EXIT;
+    return ISO15693_EC_OK;
+  }
+  const uint8_t *currentPasswords[2] = {
+    tpl->currentWritePassword ? tpl->currentWritePassword : defaultWritePassword,
+    tpl->currentPrivacyPassword ? tpl->currentPrivacyPassword : defaultPrivacyPassword
+  };
+
+  ISO15693ErrorCode rc = selectTag(uid);
+  unsigned long stepTime = micros();
+  if ((ISO15693_EC_OK == rc) && tpl->image) {
+    ISO15693UpdateStats updateStats;
+    rc = updateTagMemory(uid, tpl->image, tpl->imageSize, NULL, &updateStats);
+    result->blocksWritten = updateStats.blocksWritten;
+    ISO15693SystemInfo info;
+    if ((ISO15693_EC_OK == rc) && tpl->lockBlocks) {
+      rc = getSystemInfo(uid, &info); // cached
+    }
+    if ((ISO15693_EC_OK == rc) && tpl->lockBlocks) {
+      for (uint16_t block=0; (block < tpl->imageSize / info.blockSize) && (ISO15693_EC_OK == rc); block++) {
+        bool locked;
+        rc = getBlockLocked(uid, uint8_t(block), &locked);
+        if ((ISO15693_EC_OK == rc) && !locked) rc = lockBlock(uid, uint8_t(block));
+      }
+    }
+  }
+  result->memoryUs = micros() - stepTime;
+
+  stepTime = micros();
+  if ((ISO15693_EC_OK == rc) && (ISO15693_NO_AFI != tpl->afi) && !afiMarker) {
+    rc = commissionAfi(uid, tpl);
+  }
+  result->configUs = micros() - stepTime;
+
+  stepTime = micros();
+  uint8_t random[2];
+  if ((ISO15693_EC_OK == rc) && (tpl->writePassword || tpl->privacyPassword || tpl->enablePrivacy)) {
+    rc = getRandomNumber(uid, random);
+  }
+  const uint8_t passwordIds[2] = { 0x02, 0x04 }; // write, privacy
+  const uint8_t *newPasswords[2] = { tpl->writePassword, tpl->privacyPassword };
+  for (uint8_t i=0; (i<2) && (ISO15693_EC_OK == rc); i++) {
+    if (0L == newPasswords[i]) continue;
+    rc = setPassword(uid, passwordIds[i], currentPasswords[i], random);
+    if (ISO15693_EC_OK == rc) rc = writePassword(uid, passwordIds[i], newPasswords[i]);
+    if ((ISO15693_EC_OK == rc) && tpl->lockPasswords) rc = lockPassword(uid, passwordIds[i]);
+  }
+  result->passwordUs = micros() - stepTime;
+
+  stepTime = micros();
+  if ((ISO15693_EC_OK == rc) && (tpl->dsfid >= 0)) {
+    rc = writeDSFID(uid, uint8_t(tpl->dsfid));
+    if ((ISO15693_EC_OK == rc) && tpl->lockDsfid) {
+      rc = lockDSFID(uid);
+      if (ISO15693_EC_BLOCK_ALREADY_LOCKED == rc) rc = ISO15693_EC_OK;
+    }
+  }
+  if ((ISO15693_EC_OK == rc) && afiMarker) {
+    rc = commissionAfi(uid, tpl);
+  }
+  result->configUs += micros() - stepTime;
+  if (ISO15693_EC_OK == rc) {
+    rc = deselectTag();
+  }
+  else {
+    deselectTag();
+  }
+
+  stepTime = micros();
+  if ((ISO15693_EC_OK == rc) && tpl->enablePrivacy) {
+    rc = enablePrivacy(uid, tpl->privacyPassword ? tpl->privacyPassword : currentPasswords[1], random);
+  }
+  result->privacyUs = micros() - stepTime;
+
+  result->rc = rc;
+  result->totalUs = micros() - startTime;
+  PN5180DEBUG_PRINTF("*** Commissioned, rc=%d, %lu us", rc, result->totalUs);
+  PN5180DEBUG_PRINTLN();
+  PN5180DEBUG_EXIT;
+  return rc;
+}
+
+// WRITE AFI if it differs from tpl->afi, LOCK AFI, see commissionTag()
+ISO15693ErrorCode PN5180ISO15693::commissionAfi(const uint8_t *uid, const ISO15693CommissionTemplate *tpl) {
+  ISO15693SystemInfo info;
+  ISO15693ErrorCode rc = getSystemInfo(uid, &info);
+  if ((ISO15693_EC_OK == rc) && (!(info.infoFlags & 0x02) || (info.afi != uint8_t(tpl->afi)))) {
+    rc = writeAFI(uid, uint8_t(tpl->afi));
+  }
+  if ((ISO15693_EC_OK == rc) && tpl->lockAfi) {
+    rc = lockAFI(uid);
+    if (ISO15693_EC_BLOCK_ALREADY_LOCKED == rc) rc = ISO15693_EC_OK;
+  }
+  return rc;
+}
+
 /*
  * Read single block, code=20
  *
@@ -232,17 +926,17 @@ ISO15693ErrorCode PN5180ISO15693::inventoryPoll(uint8_t *uid, uint8_t maxTags, u
  *    SOF, Flags, BlockData (len=blockLength), CRC16, EOF
  */
 ISO15693ErrorCode PN5180ISO15693::readSingleBlock(const uint8_t *uid, uint8_t blockNo, uint8_t *blockData, uint8_t blockSize) {
-  //                            flags, cmd, uid,             blockNo
-  uint8_t readSingleBlock[] = { 0x22, 0x20, 1,2,3,4,5,6,7,8, blockNo }; // UID has LSB first!
-  //                              |\- high data rate
-  //                              \-- no options, addressed by UID
-  for (int i=0; i<8; i++) {
-    readSingleBlock[2+i] = uid[i];
+  if (!cachedBlocksAvailable(uid, blockNo, 1)) {
+    return ISO15693_EC_BLOCK_NOT_AVAILABLE;
   }
+  //                        flags, cmd, uid (opt.), blockNo
+  uint8_t readSingleBlock[11];
+  uint8_t cmdLen = requestHeader(readSingleBlock, 0x20, uid);
+  readSingleBlock[cmdLen++] = blockNo;
 
 #ifdef DEBUG
   PN5180DEBUG_PRINTF("Read Single Block #%d, size=%d:", blockNo, blockSize);
-  for (int i=0; i<sizeof(readSingleBlock); i++) {
+  for (int i=0; i<cmdLen; i++) {
     PN5180DEBUG(" ");
     PN5180DEBUG(formatHex(readSingleBlock[i]));
   }
@@ -250,7 +944,7 @@ ISO15693ErrorCode PN5180ISO15693::readSingleBlock(const uint8_t *uid, uint8_t bl
 #endif
 
   uint8_t *resultPtr;
-  ISO15693ErrorCode rc = issueISO15693Command(readSingleBlock, sizeof(readSingleBlock), &resultPtr);
+  ISO15693ErrorCode rc = issueISO15693Command(readSingleBlock, cmdLen, &resultPtr, 1 + blockSize);
   if (ISO15693_EC_OK != rc) {
     return rc;
   }
@@ -309,22 +1003,21 @@ ISO15693ErrorCode PN5180ISO15693::readSingleBlock(const uint8_t *uid, uint8_t bl
  *    SOF, Resp.Flags, CRC16, EOF
  */
 ISO15693ErrorCode PN5180ISO15693::writeSingleBlock(const uint8_t *uid, uint8_t blockNo, const uint8_t *blockData, uint8_t blockSize) {
-  //                            flags, cmd, uid,             blockNo
-  uint8_t writeSingleBlock[] = { 0x22, 0x21, 1,2,3,4,5,6,7,8, blockNo }; // UID has LSB first!
-  //                               |\- high data rate
-  //                               \-- no options, addressed by UID
-
-  uint8_t writeCmdSize = sizeof(writeSingleBlock) + blockSize;
-  uint8_t *writeCmd = (uint8_t*)malloc(writeCmdSize);
-  uint8_t pos = 0;
-  writeCmd[pos++] = writeSingleBlock[0];
-  writeCmd[pos++] = writeSingleBlock[1];
-  for (int i=0; i<8; i++) {
-    writeCmd[pos++] = uid[i];
+  if (blockSize > 32) {
+    return ISO15693_EC_NOT_RECOGNIZED;
+  }
+  if (!cachedBlocksAvailable(uid, blockNo, 1)) {
+    return ISO15693_EC_BLOCK_NOT_AVAILABLE;
+  }
+  if (cachedBlocksLocked(uid, blockNo, 1)) {
+    return ISO15693_EC_BLOCK_IS_LOCKED;
   }
-  writeCmd[pos++] = blockNo;
+  //                flags, cmd, uid (opt.), blockNo, data (upto 32 bytes)
+  uint8_t writeCmd[11+32];
+  uint8_t writeCmdSize = requestHeader(writeCmd, 0x21, uid);
+  writeCmd[writeCmdSize++] = blockNo;
   for (int i=0; i<blockSize; i++) {
-    writeCmd[pos++] = blockData[i];
+    writeCmd[writeCmdSize++] = blockData[i];
   }
 
 #ifdef DEBUG
@@ -341,16 +1034,214 @@ ISO15693ErrorCode PN5180ISO15693::writeSingleBlock(const uint8_t *uid, uint8_t b
 #endif
 
   uint8_t *resultPtr;
-  ISO15693ErrorCode rc =  issueISO15693Command(writeCmd, writeCmdSize, &resultPtr);
-  if (ISO15693_EC_OK != rc) {
-    free(writeCmd);
-    return rc;
-  }
+  return issueISO15693WriteCommand(writeCmd, writeCmdSize, &resultPtr);
+}
 
-  free(writeCmd);
+/*
+ * Write multiple blocks, code=24
+ *
+ * Request format: SOF, Req.Flags, WriteMultipleBlock, UID (opt.), FirstBlockNumber, numBlocks-1,
+ *                 BlockData (len=blockSize * numBlock), CRC16, EOF
+ * Response format:
+ *  when ERROR flag is set:
+ *    SOF, Resp.Flags, ErrorCode, CRC16, EOF
+ *  when ERROR flag is NOT set:
+ *    SOF, Resp.Flags, CRC16, EOF
+ *
+ * The request is limited to 260 bytes by SEND_DATA, i.e. 62 blocks of 4 bytes.
+ * Many labels accept less blocks per request or don't support the command,
+ * see writeBlocks().
+ */
+ISO15693ErrorCode PN5180ISO15693::writeMultipleBlock(const uint8_t *uid, uint8_t blockNo, uint8_t numBlock, const uint8_t *blockData, uint8_t blockSize) {
+  uint16_t writeCmdSize = 12 + uint16_t(numBlock) * blockSize;
+  if ((0 == numBlock) || (uint16_t(blockNo) + numBlock > 256) || (writeCmdSize > ISO15693_MAX_REQUEST_LEN)) {
+    PN5180DEBUG("Write multiple block: invalid block range\n");
+    return ISO15693_EC_BLOCK_NOT_AVAILABLE;
+  }
+  if (!cachedBlocksAvailable(uid, blockNo, numBlock)) {
+    return ISO15693_EC_BLOCK_NOT_AVAILABLE;
+  }
+  if (cachedBlocksLocked(uid, blockNo, numBlock)) {
+    return ISO15693_EC_BLOCK_IS_LOCKED;
+  }
+  //                  flags, cmd, uid (opt.), 1stBlock, blocksToWrite, data
+  uint8_t writeCmd[writeCmdSize];
+  uint8_t hdrLen = requestHeader(writeCmd, 0x24, uid);
+  writeCmd[hdrLen] = blockNo;
+  writeCmd[hdrLen+1] = numBlock - 1;
+  memcpy(&writeCmd[hdrLen+2], blockData, numBlock * blockSize);
+  writeCmdSize = hdrLen + 2 + numBlock * blockSize;
+  PN5180DEBUG_PRINTF("Write Multiple Block #%d-%d, size=%d\n", blockNo, blockNo+numBlock-1, blockSize);
+
+  uint8_t *resultPtr;
+  return issueISO15693WriteCommand(writeCmd, writeCmdSize, &resultPtr);
+}
+
+/*
+ * Write numBlock blocks starting at blockNo with as few requests as possible.
+ *
+ * WRITE MULTIPLE BLOCKS is tried first with the largest chunk the 260 byte
+ * request allows. If the label rejects a chunk, the chunk size is halved for
+ * the rest of the call; labels not supporting the command at all (or not
+ * answering it) are written with back-to-back WRITE SINGLE BLOCK requests,
+ * whose frame is built once and only patched with block number and data.
+ * Locked or failed blocks (error codes 0x10-0x14) abort the write.
+ * Requests without valid response are repeated upto ISO15693_WRITE_RETRIES times.
+ */
+ISO15693ErrorCode PN5180ISO15693::writeBlocks(const uint8_t *uid, uint8_t blockNo, uint16_t numBlock, const uint8_t *blockData, uint8_t blockSize) {
+  PN5180DEBUG_PRINTF("PN5180ISO15693::writeBlocks(blockNo=%d, numBlock=%d, blockSize=%d)", blockNo, numBlock, blockSize);
+  PN5180DEBUG_PRINTLN();
+  PN5180DEBUG_ENTER;
+  if ((0 == blockSize) || (blockSize > 32) || (uint16_t(blockNo) + numBlock > 256) ||
+      !cachedBlocksAvailable(uid, blockNo, numBlock)) {
+    PN5180DEBUG_EXIT;
+    return ISO15693_EC_BLOCK_NOT_AVAILABLE;
+  }
+  if (cachedBlocksLocked(uid, blockNo, numBlock)) {
+    PN5180DEBUG_EXIT;
+    return ISO15693_EC_BLOCK_IS_LOCKED;
+  }
+
+  uint16_t maxChunk = (ISO15693_MAX_REQUEST_LEN - 12) / blockSize;
+  //                 flags, cmd, uid (opt.), blockNo, data (upto 32 bytes)
+  uint8_t singleCmd[11+32];
+  uint8_t hdrLen = requestHeader(singleCmd, 0x21, uid);
+
+  uint16_t done = 0;
+  uint8_t attempts = 0;
+  while (done < numBlock) {
+    uint16_t chunk = numBlock - done;
+    if (chunk > maxChunk) chunk = maxChunk;
+    const uint8_t *data = &blockData[done * blockSize];
+    uint8_t block = blockNo + done;
+
+    ISO15693ErrorCode rc;
+    if (chunk > 1) {
+      rc = writeMultipleBlock(uid, block, chunk, data, blockSize);
+      if ((ISO15693_EC_NOT_SUPPORTED == rc) || (ISO15693_EC_NOT_RECOGNIZED == rc) ||
+          (ISO15693_EC_OPTION_NOT_SUPPORTED == rc) || (ISO15693_EC_CUSTOM_CMD_ERROR == rc)) {
+        maxChunk = (ISO15693_EC_NOT_SUPPORTED == rc) ? 1 : chunk / 2;
+        PN5180DEBUG_PRINTF("*** Write multiple rejected, maxChunk=%d", maxChunk);
+        PN5180DEBUG_PRINTLN();
+        continue;
+      }
+    }
+    else {
+      singleCmd[hdrLen] = block;
+      memcpy(&singleCmd[hdrLen+1], data, blockSize);
+      uint8_t *resultPtr;
+      rc = issueISO15693WriteCommand(singleCmd, hdrLen + 1 + blockSize, &resultPtr);
+    }
+
+    if ((EC_NO_CARD == rc) || (ISO15693_EC_UNKNOWN_ERROR == rc)) {
+      if (chunk > 1) {
+        // some labels ignore WRITE MULTIPLE BLOCKS instead of rejecting it
+        PN5180DEBUG(F("*** Write multiple not answered, single block writes\n"));
+        maxChunk = 1;
+        attempts = 0;
+        continue;
+      }
+      if (++attempts >= ISO15693_WRITE_RETRIES) {
+        PN5180DEBUG_EXIT;
+        return rc;
+      }
+      continue;
+    }
+    if (ISO15693_EC_OK != rc) {
+      PN5180DEBUG_EXIT;
+      return rc;
+    }
+    attempts = 0;
+    done += chunk;
+  }
+
+  PN5180DEBUG_EXIT;
   return ISO15693_EC_OK;
 }
 
+/*
+ * Set the option flag for write-alike requests (writeSingleBlock,
+ * writeMultipleBlock, writeBlocks, extendedWriteSingleBlock). Labels like
+ * TI Tag-it require it: they respond after an EOF sent eofDelayUs after the
+ * request, the time needed to program the EEPROM.
+ */
+void PN5180ISO15693::setWriteOption(bool optionFlag, uint32_t eofDelayUs) {
+  writeOptionFlag = optionFlag;
+  writeEofDelayUs = eofDelayUs;
+}
+
+/*
+ * Lock block, code=22
+ *
+ * Request format: SOF, Req.Flags, LockBlock, UID (opt.), BlockNumber, CRC16, EOF
+ * Response format: SOF, Resp.Flags, [ErrorCode,] CRC16, EOF
+ *
+ * Permanent, the block can't be written anymore.
+ */
+ISO15693ErrorCode PN5180ISO15693::lockBlock(const uint8_t *uid, uint8_t blockNo) {
+  //                 flags, cmd, uid (opt.), blockNo
+  uint8_t lockCmd[11];
+  uint8_t cmdLen = requestHeader(lockCmd, 0x22, uid);
+  lockCmd[cmdLen++] = blockNo;
+  PN5180DEBUG_PRINTF("Lock Block #%d\n", blockNo);
+
+  uint8_t *resultPtr;
+  ISO15693ErrorCode rc = issueISO15693WriteCommand(lockCmd, cmdLen, &resultPtr);
+  if (ISO15693_EC_OK == rc) {
+    ISO15693CacheEntry *entry = findCacheEntry(uid);
+    if (entry && entry->hasSecurity) entry->locked[blockNo/8] |= (1 << (blockNo%8));
+  }
+  return rc;
+}
+
+/*
+ * Write AFI, code=27; Lock AFI, code=28; Write DSFID, code=29; Lock DSFID, code=2A
+ *
+ * Request format: SOF, Req.Flags, Cmd, UID (opt.), [AFI|DSFID,] CRC16, EOF
+ * Response format: SOF, Resp.Flags, [ErrorCode,] CRC16, EOF
+ *
+ * Locking is permanent. The cached system information is updated.
+ */
+ISO15693ErrorCode PN5180ISO15693::writeAFI(const uint8_t *uid, uint8_t afi) {
+  return writeConfigByte(uid, 0x27, afi);
+}
+
+ISO15693ErrorCode PN5180ISO15693::lockAFI(const uint8_t *uid) {
+  return writeConfigByte(uid, 0x28, -1);
+}
+
+ISO15693ErrorCode PN5180ISO15693::writeDSFID(const uint8_t *uid, uint8_t dsfid) {
+  return writeConfigByte(uid, 0x29, dsfid);
+}
+
+ISO15693ErrorCode PN5180ISO15693::lockDSFID(const uint8_t *uid) {
+  return writeConfigByte(uid, 0x2A, -1);
+}
+
+// value < 0: no parameter (lock commands)
+ISO15693ErrorCode PN5180ISO15693::writeConfigByte(const uint8_t *uid, uint8_t cmd, int16_t value) {
+  //                   flags, cmd, uid (opt.), [value]
+  uint8_t configCmd[11];
+  uint8_t cmdLen = requestHeader(configCmd, cmd, uid);
+  if (value >= 0) configCmd[cmdLen++] = uint8_t(value);
+  PN5180DEBUG_PRINTF("Write config 0x%X, value=%d\n", cmd, value);
+
+  uint8_t *resultPtr;
+  ISO15693ErrorCode rc = issueISO15693WriteCommand(configCmd, cmdLen, &resultPtr);
+  if (ISO15693_EC_OK == rc) {
+    ISO15693CacheEntry *entry = findCacheEntry(uid);
+    if (entry && (0x27 == cmd)) {
+      entry->info.afi = uint8_t(value);
+      entry->info.infoFlags |= 0x02;
+    }
+    if (entry && (0x29 == cmd)) {
+      entry->info.dsfid = uint8_t(value);
+      entry->info.infoFlags |= 0x01;
+    }
+  }
+  return rc;
+}
+
 /*
  * Read multiple block, code=23
  *
@@ -380,23 +1271,24 @@ ISO15693ErrorCode PN5180ISO15693::writeSingleBlock(const uint8_t *uid, uint8_t b
  *    SOF, Flags, BlockData (len=blockSize * numBlock), CRC16, EOF
  */
 ISO15693ErrorCode PN5180ISO15693::readMultipleBlock(const uint8_t *uid, uint8_t blockNo, uint8_t numBlock, uint8_t *blockData, uint8_t blockSize) {
-  if(blockNo > numBlock-1){ // Attempted to start at a block greater than the num blocks on the VICC
-    PN5180DEBUG("Starting block exceeds length of data");
+  if ((0 == numBlock) || (uint16_t(blockNo) + numBlock > 256)) { // 8 bit block numbers
+    PN5180DEBUG("Block range exceeds the address space");
     return ISO15693_EC_BLOCK_NOT_AVAILABLE;
   }
-  if( (blockNo + numBlock) > numBlock ){ // Will attempt to read a block greater than the num blocks on the VICC 
+  if (1 + uint16_t(numBlock) * blockSize > ISO15693_MAX_RESPONSE_LEN) { // Response won't fit into the reception buffer
+    PN5180DEBUG("Response exceeds length of the reception buffer");
+    return ISO15693_EC_UNKNOWN_ERROR;
+  }
+  if (!cachedBlocksAvailable(uid, blockNo, numBlock)) { // beyond the memory size of this VICC
     PN5180DEBUG("End of block exceeds length of data");
     return ISO15693_EC_BLOCK_NOT_AVAILABLE;
   }
   
-  //                              flags, cmd, uid,             1stBlock blocksToRead  
-  uint8_t readMultipleCmd[12] = { 0x22, 0x23, 1,2,3,4,5,6,7,8, blockNo, uint8_t(numBlock-1) }; // UID has LSB first!
-  //                                |\- high data rate
-  //                                \-- no options, addressed by UID
-  
-  for (int i=0; i<8; i++) {
-    readMultipleCmd[2+i] = uid[i];
-  }
+  //                        flags, cmd, uid (opt.), 1stBlock blocksToRead
+  uint8_t readMultipleCmd[12];
+  uint8_t cmdLen = requestHeader(readMultipleCmd, 0x23, uid);
+  readMultipleCmd[cmdLen++] = blockNo;
+  readMultipleCmd[cmdLen++] = uint8_t(numBlock-1);
 
   PN5180DEBUG("readMultipleBlock: Read Block #");
   PN5180DEBUG(blockNo);
@@ -405,13 +1297,13 @@ ISO15693ErrorCode PN5180ISO15693::readMultipleBlock(const uint8_t *uid, uint8_t
   PN5180DEBUG(", blockSize=");
   PN5180DEBUG(blockSize);
   PN5180DEBUG(", Cmd: ");
-  for (int i=0; i<sizeof(readMultipleCmd); i++) {
+  for (int i=0; i<cmdLen; i++) {
     PN5180DEBUG(" ");
     PN5180DEBUG(formatHex(readMultipleCmd[i]));
   }
 
   uint8_t *resultPtr;
-  ISO15693ErrorCode rc = issueISO15693Command(readMultipleCmd, sizeof(readMultipleCmd), &resultPtr);
+  ISO15693ErrorCode rc = issueISO15693Command(readMultipleCmd, cmdLen, &resultPtr, 1 + numBlock * blockSize);
   if (ISO15693_EC_OK != rc) return rc;
 
   PN5180DEBUG("readMultipleBlock: Value=");
@@ -482,118 +1374,761 @@ ISO15693ErrorCode PN5180ISO15693::readMultipleBlock(const uint8_t *uid, uint8_t
  *        bbbbb - Block size is expressed in number of bytes, on 5 bits, allowing to specify up to 32 bytes i.e. 256 bits.
  *        nnnn.nnnn - Number of blocks is on 8 bits, allowing to specify up to 256 blocks.
  *
- *    IC reference: The IC reference is on 8 bits and its meaning is defined by the IC manufacturer.
+ *    IC reference: The IC reference is on 8 bits and its meaning is defined by the IC manufacturer.
+ */
+ISO15693ErrorCode PN5180ISO15693::getSystemInfo(uint8_t *uid, uint8_t *blockSize, uint8_t *numBlocks) {
+  ISO15693SystemInfo info;
+  ISO15693ErrorCode rc = getSystemInfo(uid, &info);
+  if (ISO15693_EC_OK != rc) {
+    return rc;
+  }
+  for (int i=0; i<8; i++) {
+    uid[i] = info.uid[i];
+  }
+  if (info.infoFlags & 0x04) { // VICC Memory size
+    *blockSize = info.blockSize;
+    *numBlocks = uint8_t(info.numBlocks); // 256 blocks wrap to 0
+  }
+  return ISO15693_EC_OK;
+}
+
+/*
+ * Get System Information into info, see above. Fields not present in the
+ * response are set to 0.
+ */
+ISO15693ErrorCode PN5180ISO15693::getSystemInfo(const uint8_t *uid, ISO15693SystemInfo *info) {
+  ISO15693CacheEntry *entry = findCacheEntry(uid);
+  if (entry) {
+    touchCacheEntry(entry);
+    *info = entry->info;
+    return ISO15693_EC_OK;
+  }
+
+  uint8_t sysInfo[10];
+  uint8_t cmdLen = requestHeader(sysInfo, 0x2b, uid);
+
+#ifdef DEBUG
+  PN5180DEBUG("Get System Information");
+  for (int i=0; i<cmdLen; i++) {
+    PN5180DEBUG(" ");
+    PN5180DEBUG(formatHex(sysInfo[i]));
+  }
+  PN5180DEBUG_PRINTLN();
+#endif
+
+  uint8_t *readBuffer;
+  ISO15693ErrorCode rc = issueISO15693Command(sysInfo, cmdLen, &readBuffer, 15);
+  if (ISO15693_EC_OK != rc) {
+    return rc;
+  }
+
+  memset(info, 0, sizeof(ISO15693SystemInfo));
+  for (int i=0; i<8; i++) {
+    info->uid[i] = readBuffer[2+i];
+  }
+  
+#ifdef DEBUG
+  PN5180DEBUG("UID=");
+  for (int i=0; i<8; i++) {
+    PN5180DEBUG(formatHex(readBuffer[9-i]));  // UID has LSB first!
+    if (i<2) PN5180DEBUG(":");
+  }
+  PN5180DEBUG_PRINTLN();
+#endif
+  
+  uint8_t *p = &readBuffer[10];
+
+  uint8_t infoFlags = readBuffer[1];
+  info->infoFlags = infoFlags;
+  if (infoFlags & 0x01) { // DSFID flag
+    uint8_t dsfid = *p++;
+    info->dsfid = dsfid;
+    PN5180DEBUG("DSFID=");  // Data storage format identifier
+    PN5180DEBUG(formatHex(dsfid));
+    PN5180DEBUG_PRINTLN();
+  }
+#ifdef DEBUG
+  else PN5180DEBUG(F("No DSFID\n"));  
+#endif
+  
+  if (infoFlags & 0x02) { // AFI flag
+    uint8_t afi = *p++;
+    info->afi = afi;
+    PN5180DEBUG(F("AFI="));  // Application family identifier
+    PN5180DEBUG(formatHex(afi));
+    PN5180DEBUG(F(" - "));
+    switch (afi >> 4) {
+      case 0: PN5180DEBUG(F("All families")); break;
+      case 1: PN5180DEBUG(F("Transport")); break;
+      case 2: PN5180DEBUG(F("Financial")); break;
+      case 3: PN5180DEBUG(F("Identification")); break;
+      case 4: PN5180DEBUG(F("Telecommunication")); break;
+      case 5: PN5180DEBUG(F("Medical")); break;
+      case 6: PN5180DEBUG(F("Multimedia")); break;
+      case 7: PN5180DEBUG(F("Gaming")); break;
+      case 8: PN5180DEBUG(F("Data storage")); break;
+      case 9: PN5180DEBUG(F("Item management")); break;
+      case 10: PN5180DEBUG(F("Express parcels")); break;
+      case 11: PN5180DEBUG(F("Postal services")); break;
+      case 12: PN5180DEBUG(F("Airline bags")); break;
+      default: PN5180DEBUG(F("Unknown")); break;
+    }
+    PN5180DEBUG_PRINTLN();
+  }
+#ifdef DEBUG
+  else PN5180DEBUG(F("No AFI\n"));
+#endif
+
+  if (infoFlags & 0x04) { // VICC Memory size
+    info->numBlocks = *p++;
+    info->blockSize = *p++;
+    info->blockSize = (info->blockSize) & 0x1f;
+
+    info->blockSize = info->blockSize + 1; // range: 1-32
+    info->numBlocks = info->numBlocks + 1; // range: 1-256
+
+    PN5180DEBUG("VICC MemSize=");
+    PN5180DEBUG(uint16_t(info->blockSize) * (info->numBlocks));
+    PN5180DEBUG(" BlockSize=");
+    PN5180DEBUG(info->blockSize);
+    PN5180DEBUG(" NumBlocks=");
+    PN5180DEBUG(info->numBlocks);
+    PN5180DEBUG_PRINTLN();
+  }
+#ifdef DEBUG
+  else PN5180DEBUG(F("No VICC memory size\n"));
+#endif
+   
+  if (infoFlags & 0x08) { // IC reference
+    uint8_t iRef = *p++;
+    info->icRef = iRef;
+    PN5180DEBUG("IC Ref=");
+    PN5180DEBUG(formatHex(iRef));
+    PN5180DEBUG_PRINTLN();
+  }
+#ifdef DEBUG
+  else PN5180DEBUG(F("No IC ref\n"));
+#endif
+
+  storeCacheEntry(info, false);
+  return ISO15693_EC_OK;
+}
+
+/*
+ * Read the complete memory of a label with READ MULTIPLE BLOCKS, code=23
+ *
+ * The geometry is taken from GET SYSTEM INFORMATION. Labels with more than
+ * 256 blocks, or without support for it, are read with the extended
+ * commands (EXTENDED GET SYSTEM INFO, EXTENDED READ MULTIPLE BLOCKS, code=33)
+ * with 16 bit block numbers. The blocks are read in the largest chunks that
+ * fit into the reception buffer (508 bytes incl. the response flags, e.g.
+ * 126 blocks of 4 bytes); if the label rejects a chunk with an error code, the
+ * chunk size is halved for the rest of the read. A chunk without valid
+ * response is read again, upto ISO15693_READ_RETRIES times.
+ *
+ * buffer: receives the memory, block 0 first, may be NULL if callback is set.
+ *         The read stops at bufferSize bytes.
+ * callback: called with each chunk as soon as it was received, may be NULL
+ * stats: bytes, chunks, retries, time and throughput, may be NULL
+ */
+ISO15693ErrorCode PN5180ISO15693::readTagMemory(const uint8_t *uid, uint8_t *buffer, uint16_t bufferSize,
+                                                ISO15693ReadCallback callback, ISO15693ReadStats *stats) {
+  PN5180DEBUG_PRINTF("PN5180ISO15693::readTagMemory(bufferSize=%d)", bufferSize);
+  PN5180DEBUG_PRINTLN();
+  PN5180DEBUG_ENTER;
+  unsigned long startTime = micros();
+  ISO15693ReadStats s = { 0, 0, 0, 0, 0.0f };
+
+  ISO15693SystemInfo info;
+  ISO15693ErrorCode rc = getSystemInfo(uid, &info);
+  bool extended = false;
+  if ((ISO15693_EC_OK != rc) || (info.numBlocks >= 256)) {
+    // large labels: geometry and blocks beyond 255 via the extended commands only
+    ISO15693SystemInfo extInfo;
+    if (ISO15693_EC_OK == extendedGetSystemInfo(uid, &extInfo)) {
+      info = extInfo;
+      extended = true;
+      rc = ISO15693_EC_OK;
+    }
+  }
+  if (ISO15693_EC_OK != rc) {
+    PN5180DEBUG_EXIT;
+    return rc;
+  }
+  if (0 == info.numBlocks) {
+    PN5180DEBUG(F("*** Memory size not reported\n"));
+    PN5180DEBUG_EXIT;
+    return ISO15693_EC_NOT_SUPPORTED;
+  }
+
+  uint16_t numBlocks = info.numBlocks;
+  if ((0L != buffer) && (numBlocks > bufferSize / info.blockSize)) {
+    numBlocks = bufferSize / info.blockSize;
+  }
+  uint16_t maxChunk = (ISO15693_MAX_RESPONSE_LEN - 1) / info.blockSize;
+  if (!extended && (maxChunk > 255)) maxChunk = 255;
+
+  //                        flags, cmd, uid (opt.), 1stBlock blocksToRead (8 or 16 bit each)
+  uint8_t readMultipleCmd[14];
+  uint8_t hdrLen = requestHeader(readMultipleCmd, extended ? 0x33 : 0x23, uid);
+  uint8_t cmdLen = hdrLen + (extended ? 4 : 2);
+
+  uint16_t block = 0;
+  uint8_t attempts = 0;
+  while (block < numBlocks) {
+    uint16_t chunk = numBlocks - block;
+    if (chunk > maxChunk) chunk = maxChunk;
+    if (extended) {
+      readMultipleCmd[hdrLen] = uint8_t(block);
+      readMultipleCmd[hdrLen+1] = uint8_t(block >> 8);
+      readMultipleCmd[hdrLen+2] = uint8_t(chunk - 1);
+      readMultipleCmd[hdrLen+3] = uint8_t((chunk - 1) >> 8);
+    }
+    else {
+      readMultipleCmd[hdrLen] = uint8_t(block);
+      readMultipleCmd[hdrLen+1] = uint8_t(chunk - 1);
+    }
+
+    uint16_t len = chunk * info.blockSize;
+    uint8_t *resultPtr;
+    rc = issueISO15693Command(readMultipleCmd, cmdLen, &resultPtr, 1 + len);
+    if ((ISO15693_EC_OK == rc) && (lastResponseLen < 1 + len)) {
+      rc = ISO15693_EC_UNKNOWN_ERROR; // truncated response
+    }
+    if (ISO15693_EC_OK != rc) {
+      if ((EC_NO_CARD != rc) && (ISO15693_EC_UNKNOWN_ERROR != rc) && (chunk > 1)) {
+        maxChunk = chunk / 2; // rejected by the label, try smaller chunks
+        PN5180DEBUG_PRINTF("*** Chunk rejected, maxChunk=%d", maxChunk);
+        PN5180DEBUG_PRINTLN();
+        continue;
+      }
+      if (++attempts >= ISO15693_READ_RETRIES) {
+        PN5180DEBUG_EXIT;
+        return rc;
+      }
+      s.retries++;
+      continue;
+    }
+    attempts = 0;
+
+    uint16_t offset = block * info.blockSize; // buffer limit: 64k
+    if (0L != buffer) {
+      memcpy(&buffer[offset], &resultPtr[1], len);
+    }
+    if (callback) {
+      callback(offset, &resultPtr[1], len);
+    }
+    s.bytes += len;
+    s.chunks++;
+    block += chunk;
+  }
+
+  s.timeUs = micros() - startTime;
+  if (s.timeUs > 0) {
+    s.bytesPerSecond = float(s.bytes) * 1000000.0f / s.timeUs;
+  }
+  if (stats) *stats = s;
+
+  PN5180DEBUG_PRINTF("*** Read %d bytes in %d chunks, %lu us", s.bytes, s.chunks, s.timeUs);
+  PN5180DEBUG_PRINTLN();
+  PN5180DEBUG_EXIT;
+  return ISO15693_EC_OK;
+}
+
+/*
+ * Write the memory image to the label, changed blocks only.
+ *
+ * image: desired content from block 0, size bytes (a multiple of the block
+ *        size, upto 256 blocks). The geometry is taken from GET SYSTEM
+ *        INFORMATION.
+ * current: known content of the label (size bytes), e.g. of a previous
+ *          readTagMemory() or updateTagMemory(), or NULL. If NULL, the label
+ *          is read in windows of ISO15693_UPDATE_WINDOW bytes with READ
+ *          MULTIPLE BLOCKS. On success, current is updated to image.
+ * stats: blocks skipped and written, may be NULL
+ *
+ * Each run of consecutive changed blocks is written with writeBlocks(),
+ * i.e. WRITE MULTIPLE BLOCKS where the label supports it, and read back.
+ * Returns ISO15693_EC_BLOCK_NOT_PROGRAMMED if the read back differs.
+ * Unchanged blocks are not programmed, saving time and EEPROM cycles.
+ */
+ISO15693ErrorCode PN5180ISO15693::updateTagMemory(const uint8_t *uid, const uint8_t *image, uint16_t size,
+                                                  uint8_t *current, ISO15693UpdateStats *stats) {
+  PN5180DEBUG_PRINTF("PN5180ISO15693::updateTagMemory(size=%d)", size);
+  PN5180DEBUG_PRINTLN();
+  PN5180DEBUG_ENTER;
+  unsigned long startTime = micros();
+  ISO15693UpdateStats s = { 0, 0, 0, 0 };
+  if (stats) *stats = s;
+
+  ISO15693SystemInfo info;
+  ISO15693ErrorCode rc = getSystemInfo(uid, &info);
+  if (ISO15693_EC_OK != rc) {
+    PN5180DEBUG_EXIT;
+    return rc;
+  }
+  uint8_t blockSize = info.blockSize;
+  uint16_t numBlocks = size / blockSize;
+  if ((0 == blockSize) || (blockSize > ISO15693_UPDATE_WINDOW) || (size % blockSize) || (numBlocks > 256) ||
+      ((0 != info.numBlocks) && (numBlocks > info.numBlocks))) {
+    PN5180DEBUG(F("*** Image does not match the memory\n"));
+    PN5180DEBUG_EXIT;
+    return ISO15693_EC_BLOCK_NOT_AVAILABLE;
+  }
+
+  uint8_t window[ISO15693_UPDATE_WINDOW];
+  uint16_t windowBlocks = ISO15693_UPDATE_WINDOW / blockSize;
+  uint16_t block = 0;
+  while (block < numBlocks) {
+    uint16_t chunk = numBlocks - block;
+    if (chunk > windowBlocks) chunk = windowBlocks;
+    uint16_t offset = block * blockSize;
+
+    if (0L != current) {
+      memcpy(window, &current[offset], chunk * blockSize);
+    }
+    else {
+      rc = readMultipleBlock(uid, uint8_t(block), uint8_t(chunk), window, blockSize);
+      if ((ISO15693_EC_OK != rc) && (EC_NO_CARD != rc) && (ISO15693_EC_UNKNOWN_ERROR != rc) && (windowBlocks > 1)) {
+        windowBlocks = chunk / 2; // rejected by the label, try smaller windows
+        if (0 == windowBlocks) windowBlocks = 1;
+        continue;
+      }
+      if (ISO15693_EC_OK != rc) {
+        PN5180DEBUG_EXIT;
+        return rc;
+      }
+    }
+
+    uint16_t i = 0;
+    while (i < chunk) {
+      if (0 == memcmp(&window[i * blockSize], &image[offset + i * blockSize], blockSize)) {
+        s.blocksSkipped++;
+        i++;
+        continue;
+      }
+      uint16_t runStart = i;
+      while ((i < chunk) && (0 != memcmp(&window[i * blockSize], &image[offset + i * blockSize], blockSize))) {
+        i++;
+      }
+      uint16_t runLen = i - runStart;
+      uint8_t runBlock = uint8_t(block + runStart);
+      const uint8_t *runData = &image[offset + runStart * blockSize];
+      PN5180DEBUG_PRINTF("*** Blocks %d-%d changed", runBlock, runBlock + runLen - 1);
+      PN5180DEBUG_PRINTLN();
+
+      rc = writeBlocks(uid, runBlock, runLen, runData, blockSize);
+      if (ISO15693_EC_OK == rc) {
+        // verify, the window of this run is no longer needed
+        rc = readMultipleBlock(uid, runBlock, uint8_t(runLen), &window[runStart * blockSize], blockSize);
+      }
+      if ((ISO15693_EC_OK == rc) && (0 != memcmp(&window[runStart * blockSize], runData, runLen * blockSize))) {
+        rc = ISO15693_EC_BLOCK_NOT_PROGRAMMED;
+      }
+      if (ISO15693_EC_OK != rc) {
+        if (stats) *stats = s;
+        PN5180DEBUG_EXIT;
+        return rc;
+      }
+      if (0L != current) {
+        memcpy(&current[offset + runStart * blockSize], runData, runLen * blockSize);
+      }
+      s.blocksWritten += runLen;
+      s.runs++;
+    }
+    block += chunk;
+  }
+
+  s.timeUs = micros() - startTime;
+  if (stats) *stats = s;
+  PN5180DEBUG_PRINTF("*** %d blocks written, %d skipped, %lu us", s.blocksWritten, s.blocksSkipped, s.timeUs);
+  PN5180DEBUG_PRINTLN();
+  PN5180DEBUG_EXIT;
+  return ISO15693_EC_OK;
+}
+
+/*
+ * Extended read single block, code=30
+ *
+ * Request format: SOF, Req.Flags, ExtReadSingleBlock, UID (opt.), BlockNumber (LSB, MSB), CRC16, EOF
+ * Response format:
+ *  when ERROR flag is set:
+ *    SOF, Resp.Flags, ErrorCode, CRC16, EOF
+ *  when ERROR flag is NOT set:
+ *    SOF, Flags, BlockData (len=blockLength), CRC16, EOF
+ */
+ISO15693ErrorCode PN5180ISO15693::extendedReadSingleBlock(const uint8_t *uid, uint16_t blockNo, uint8_t *blockData, uint8_t blockSize) {
+  //                        flags, cmd, uid (opt.), blockNo (LSB, MSB)
+  uint8_t readSingleBlock[12];
+  uint8_t cmdLen = requestHeader(readSingleBlock, 0x30, uid);
+  readSingleBlock[cmdLen++] = uint8_t(blockNo);
+  readSingleBlock[cmdLen++] = uint8_t(blockNo >> 8);
+  PN5180DEBUG_PRINTF("Extended Read Single Block #%d, size=%d\n", blockNo, blockSize);
+
+  uint8_t *resultPtr;
+  ISO15693ErrorCode rc = issueISO15693Command(readSingleBlock, cmdLen, &resultPtr, 1 + blockSize);
+  if (ISO15693_EC_OK != rc) return rc;
+
+  for (int i=0; i<blockSize; i++) {
+    blockData[i] = resultPtr[1+i];
+  }
+  return ISO15693_EC_OK;
+}
+
+/*
+ * Extended write single block, code=31
+ *
+ * Request format: SOF, Req.Flags, ExtWriteSingleBlock, UID (opt.), BlockNumber (LSB, MSB), BlockData, CRC16, EOF
+ * Response format:
+ *  when ERROR flag is set:
+ *    SOF, Resp.Flags, ErrorCode, CRC16, EOF
+ *  when ERROR flag is NOT set:
+ *    SOF, Resp.Flags, CRC16, EOF
+ */
+ISO15693ErrorCode PN5180ISO15693::extendedWriteSingleBlock(const uint8_t *uid, uint16_t blockNo, const uint8_t *blockData, uint8_t blockSize) {
+  if (blockSize > 32) {
+    return ISO15693_EC_NOT_RECOGNIZED;
+  }
+  //                flags, cmd, uid (opt.), blockNo (LSB, MSB), data (upto 32 bytes)
+  uint8_t writeCmd[12+32];
+  uint8_t cmdLen = requestHeader(writeCmd, 0x31, uid);
+  writeCmd[cmdLen++] = uint8_t(blockNo);
+  writeCmd[cmdLen++] = uint8_t(blockNo >> 8);
+  for (int i=0; i<blockSize; i++) {
+    writeCmd[cmdLen++] = blockData[i];
+  }
+  PN5180DEBUG_PRINTF("Extended Write Single Block #%d, size=%d\n", blockNo, blockSize);
+
+  uint8_t *resultPtr;
+  return issueISO15693WriteCommand(writeCmd, cmdLen, &resultPtr);
+}
+
+/*
+ * Extended read multiple block, code=33
+ *
+ * Request format: SOF, Req.Flags, ExtReadMultipleBlock, UID (opt.), FirstBlockNumber (LSB, MSB),
+ *                 numBlocks-1 (LSB, MSB), CRC16, EOF
+ * Response format:
+ *  when ERROR flag is set:
+ *    SOF, Resp.Flags, ErrorCode, CRC16, EOF
+ *  when ERROR flag is NOT set:
+ *    SOF, Flags, BlockData (len=blockSize * numBlock), CRC16, EOF
+ *
+ * numBlock * blockSize is limited by the reception buffer to 507 bytes.
  */
-ISO15693ErrorCode PN5180ISO15693::getSystemInfo(uint8_t *uid, uint8_t *blockSize, uint8_t *numBlocks) {
-  uint8_t sysInfo[] = { 0x22, 0x2b, 1,2,3,4,5,6,7,8 };  // UID has LSB first!
-  for (int i=0; i<8; i++) {
-    sysInfo[2+i] = uid[i];
+ISO15693ErrorCode PN5180ISO15693::extendedReadMultipleBlock(const uint8_t *uid, uint16_t blockNo, uint16_t numBlock, uint8_t *blockData, uint8_t blockSize) {
+  if ((0 == numBlock) || (uint32_t(blockNo) + numBlock > 65536UL)) {
+    PN5180DEBUG("Block range exceeds the address space");
+    return ISO15693_EC_BLOCK_NOT_AVAILABLE;
   }
+  if (1 + uint32_t(numBlock) * blockSize > ISO15693_MAX_RESPONSE_LEN) {
+    PN5180DEBUG("Response exceeds length of the reception buffer");
+    return ISO15693_EC_UNKNOWN_ERROR;
+  }
+  //                        flags, cmd, uid (opt.), 1stBlock (LSB, MSB), blocksToRead (LSB, MSB)
+  uint8_t readMultipleCmd[14];
+  uint8_t cmdLen = requestHeader(readMultipleCmd, 0x33, uid);
+  readMultipleCmd[cmdLen++] = uint8_t(blockNo);
+  readMultipleCmd[cmdLen++] = uint8_t(blockNo >> 8);
+  readMultipleCmd[cmdLen++] = uint8_t(numBlock-1);
+  readMultipleCmd[cmdLen++] = uint8_t((numBlock-1) >> 8);
+  PN5180DEBUG_PRINTF("Extended Read Multiple Block #%d-%d, size=%d\n", blockNo, blockNo+numBlock-1, blockSize);
 
-#ifdef DEBUG
-  PN5180DEBUG("Get System Information");
-  for (int i=0; i<sizeof(sysInfo); i++) {
-    PN5180DEBUG(" ");
-    PN5180DEBUG(formatHex(sysInfo[i]));
+  uint16_t len = numBlock * blockSize;
+  uint8_t *resultPtr;
+  ISO15693ErrorCode rc = issueISO15693Command(readMultipleCmd, cmdLen, &resultPtr, 1 + len);
+  if (ISO15693_EC_OK != rc) return rc;
+  if (lastResponseLen < 1 + len) return ISO15693_EC_UNKNOWN_ERROR;
+
+  memcpy(blockData, &resultPtr[1], len);
+  return ISO15693_EC_OK;
+}
+
+/*
+ * Extended get system information, code=3B
+ *
+ * Request format: SOF, Req.Flags, ExtGetSysInfo, InfoRequest, UID (opt.), CRC16, EOF
+ *    InfoRequest: 0x01 DSFID, 0x02 AFI, 0x04 memory size, 0x08 IC reference
+ * Response format:
+ *  when ERROR flag is NOT set:
+ *    SOF, Flags, InfoFlags, UID, DSFID (opt.), AFI (opt.), Memory size (opt.), IC reference (opt.), CRC16, EOF
+ *
+ *    Memory size:
+ *      nnnn.nnnn nnnn.nnnn xxxb.bbbb
+ *        nnnn - Number of blocks - 1, 16 bits, LSB first
+ *        bbbbb - Block size - 1 in bytes
+ */
+ISO15693ErrorCode PN5180ISO15693::extendedGetSystemInfo(const uint8_t *uid, ISO15693SystemInfo *info) {
+  ISO15693CacheEntry *entry = findCacheEntry(uid);
+  if (entry && entry->extended) {
+    touchCacheEntry(entry);
+    *info = entry->info;
+    return ISO15693_EC_OK;
   }
-  PN5180DEBUG_PRINTLN();
-#endif
+  //                flags, cmd, request, uid (opt.)
+  uint8_t sysInfo[11];
+  uint8_t cmdLen = requestHeader(sysInfo, 0x3b, uid);
+  // the info request byte precedes the UID
+  for (uint8_t i=cmdLen; i>2; i--) {
+    sysInfo[i] = sysInfo[i-1];
+  }
+  sysInfo[2] = 0x0f; // DSFID, AFI, memory size, IC reference
+  cmdLen++;
+  PN5180DEBUG(F("Extended Get System Information\n"));
 
   uint8_t *readBuffer;
-  ISO15693ErrorCode rc = issueISO15693Command(sysInfo, sizeof(sysInfo), &readBuffer);
+  ISO15693ErrorCode rc = issueISO15693Command(sysInfo, cmdLen, &readBuffer, 16);
   if (ISO15693_EC_OK != rc) {
     return rc;
   }
 
+  memset(info, 0, sizeof(ISO15693SystemInfo));
+  info->infoFlags = readBuffer[1];
   for (int i=0; i<8; i++) {
-    uid[i] = readBuffer[2+i];
-  }
-  
-#ifdef DEBUG
-  PN5180DEBUG("UID=");
-  for (int i=0; i<8; i++) {
-    PN5180DEBUG(formatHex(readBuffer[9-i]));  // UID has LSB first!
-    if (i<2) PN5180DEBUG(":");
+    info->uid[i] = readBuffer[2+i];
   }
-  PN5180DEBUG_PRINTLN();
-#endif
-  
   uint8_t *p = &readBuffer[10];
+  if (info->infoFlags & 0x01) info->dsfid = *p++;
+  if (info->infoFlags & 0x02) info->afi = *p++;
+  if (info->infoFlags & 0x04) {
+    info->numBlocks = uint16_t(p[0] | (p[1] << 8)) + 1;
+    info->blockSize = (p[2] & 0x1f) + 1;
+    p += 3;
+  }
+  if (info->infoFlags & 0x08) info->icRef = *p++;
 
-  uint8_t infoFlags = readBuffer[1];
-  if (infoFlags & 0x01) { // DSFID flag
-    uint8_t __attribute__((unused)) dsfid = *p++;
-    PN5180DEBUG("DSFID=");  // Data storage format identifier
-    PN5180DEBUG(formatHex(dsfid));
-    PN5180DEBUG_PRINTLN();
+  PN5180DEBUG_PRINTF("InfoFlags=0x%X, NumBlocks=%u, BlockSize=%d\n", info->infoFlags, info->numBlocks, info->blockSize);
+  storeCacheEntry(info, true);
+  return ISO15693_EC_OK;
+}
+
+/*
+ * Get multiple block security status, code=2C
+ *
+ * Request format: SOF, Req.Flags, GetMultipleBlockSecStatus, UID (opt.), FirstBlockNumber, numBlocks-1, CRC16, EOF
+ * Response format:
+ *  when ERROR flag is NOT set:
+ *    SOF, Flags, BlockSecurityStatus (1 byte per block), CRC16, EOF
+ *
+ *    BlockSecurityStatus:
+ *    xxxx.xxx0
+ *            \_ 0=not locked, 1=locked
+ */
+ISO15693ErrorCode PN5180ISO15693::getMultipleBlockSecurityStatus(const uint8_t *uid, uint8_t blockNo, uint16_t numBlock, uint8_t *status) {
+  if ((0 == numBlock) || (uint16_t(blockNo) + numBlock > 256)) {
+    return ISO15693_EC_BLOCK_NOT_AVAILABLE;
   }
-#ifdef DEBUG
-  else PN5180DEBUG(F("No DSFID\n"));  
-#endif
-  
-  if (infoFlags & 0x02) { // AFI flag
-    uint8_t afi = *p++;
-    PN5180DEBUG(F("AFI="));  // Application family identifier
-    PN5180DEBUG(formatHex(afi));
-    PN5180DEBUG(F(" - "));
-    switch (afi >> 4) {
-      case 0: PN5180DEBUG(F("All families")); break;
-      case 1: PN5180DEBUG(F("Transport")); break;
-      case 2: PN5180DEBUG(F("Financial")); break;
-      case 3: PN5180DEBUG(F("Identification")); break;
-      case 4: PN5180DEBUG(F("Telecommunication")); break;
-      case 5: PN5180DEBUG(F("Medical")); break;
-      case 6: PN5180DEBUG(F("Multimedia")); break;
-      case 7: PN5180DEBUG(F("Gaming")); break;
-      case 8: PN5180DEBUG(F("Data storage")); break;
-      case 9: PN5180DEBUG(F("Item management")); break;
-      case 10: PN5180DEBUG(F("Express parcels")); break;
-      case 11: PN5180DEBUG(F("Postal services")); break;
-      case 12: PN5180DEBUG(F("Airline bags")); break;
-      default: PN5180DEBUG(F("Unknown")); break;
+  //                    flags, cmd, uid (opt.), 1stBlock, numBlocks-1
+  uint8_t securityCmd[12];
+  uint8_t cmdLen = requestHeader(securityCmd, 0x2c, uid);
+  securityCmd[cmdLen++] = blockNo;
+  securityCmd[cmdLen++] = uint8_t(numBlock-1);
+  PN5180DEBUG_PRINTF("Get Multiple Block Security Status #%d-%d\n", blockNo, blockNo+numBlock-1);
+
+  uint8_t *resultPtr;
+  ISO15693ErrorCode rc = issueISO15693Command(securityCmd, cmdLen, &resultPtr, 1 + numBlock);
+  if (ISO15693_EC_OK != rc) return rc;
+  if (lastResponseLen < 1 + numBlock) return ISO15693_EC_UNKNOWN_ERROR;
+
+  memcpy(status, &resultPtr[1], numBlock);
+  return ISO15693_EC_OK;
+}
+
+/*
+ * Lock state of a block, from the cache if the security status of the
+ * label is known, otherwise the status of all its blocks (upto 256) is read
+ * with one GET MULTIPLE BLOCK SECURITY STATUS and cached.
+ */
+ISO15693ErrorCode PN5180ISO15693::getBlockLocked(const uint8_t *uid, uint8_t blockNo, bool *locked) {
+  ISO15693SystemInfo info;
+  ISO15693ErrorCode rc = getSystemInfo(uid, &info); // creates the cache entry
+  if (ISO15693_EC_OK != rc) return rc;
+  ISO15693CacheEntry *entry = findCacheEntry(uid);
+  if ((0L == entry) || (0 == info.numBlocks) || (blockNo >= info.numBlocks)) {
+    return ISO15693_EC_BLOCK_NOT_AVAILABLE;
+  }
+
+  if (!entry->hasSecurity) {
+    uint16_t numBlocks = (info.numBlocks > 256) ? 256 : info.numBlocks;
+    uint8_t status[numBlocks];
+    rc = getMultipleBlockSecurityStatus(uid, 0, numBlocks, status);
+    if (ISO15693_EC_OK != rc) return rc;
+    entry = findCacheEntry(uid); // still there, nothing was stored in between
+    memset(entry->locked, 0, sizeof(entry->locked));
+    for (uint16_t i=0; i<numBlocks; i++) {
+      if (status[i] & 0x01) entry->locked[i/8] |= (1 << (i%8));
     }
-    PN5180DEBUG_PRINTLN();
+    entry->hasSecurity = true;
   }
-#ifdef DEBUG
-  else PN5180DEBUG(F("No AFI\n"));
-#endif
 
-  if (infoFlags & 0x04) { // VICC Memory size
-    *numBlocks = *p++;
-    *blockSize = *p++;
-    *blockSize = (*blockSize) & 0x1f;
+  *locked = (0 != (entry->locked[blockNo/8] & (1 << (blockNo%8))));
+  return ISO15693_EC_OK;
+}
 
-    *blockSize = *blockSize + 1; // range: 1-32
-    *numBlocks = *numBlocks + 1; // range: 1-256
+/*
+ * Cache of system information and block security status, ISO15693_CACHE_SIZE
+ * labels, least recently used entry is replaced.
+ * Call invalidateCache() after the memory layout or the lock state of a label
+ * was changed by other means, or when the label left the field.
+ */
+void PN5180ISO15693::invalidateCache(const uint8_t *uid) {
+  for (uint8_t i=0; i<ISO15693_CACHE_SIZE; i++) {
+    if ((0L == uid) || (0 == memcmp(cache[i].info.uid, uid, 8))) {
+      cache[i].valid = false;
+    }
+  }
+}
 
-    PN5180DEBUG("VICC MemSize=");
-    PN5180DEBUG(uint16_t(*blockSize) * (*numBlocks));
-    PN5180DEBUG(" BlockSize=");
-    PN5180DEBUG(*blockSize);
-    PN5180DEBUG(" NumBlocks=");
-    PN5180DEBUG(*numBlocks);
-    PN5180DEBUG_PRINTLN();
+// lookup only, the LRU timestamp is updated by touchCacheEntry() on a read hit
+ISO15693CacheEntry *PN5180ISO15693::findCacheEntry(const uint8_t *uid) {
+  for (uint8_t i=0; i<ISO15693_CACHE_SIZE; i++) {
+    if (cache[i].valid && (0 == memcmp(cache[i].info.uid, uid, 8))) {
+      return &cache[i];
+    }
   }
-#ifdef DEBUG
-  else PN5180DEBUG(F("No VICC memory size\n"));
-#endif
-   
-  if (infoFlags & 0x08) { // IC reference
-	uint8_t __attribute__((unused)) iRef = *p++;
-    PN5180DEBUG("IC Ref=");
-    PN5180DEBUG(formatHex(iRef));
-    PN5180DEBUG_PRINTLN();
+  return 0L;
+}
+
+void PN5180ISO15693::touchCacheEntry(ISO15693CacheEntry *entry) {
+  entry->lastUsed = ++cacheClock;
+}
+
+void PN5180ISO15693::storeCacheEntry(const ISO15693SystemInfo *info, bool extended) {
+  ISO15693CacheEntry *entry = findCacheEntry(info->uid);
+  if (0L == entry) {
+    entry = &cache[0];
+    for (uint8_t i=0; i<ISO15693_CACHE_SIZE; i++) {
+      if (!cache[i].valid) {
+        entry = &cache[i];
+        break;
+      }
+      if (cache[i].lastUsed < entry->lastUsed) entry = &cache[i];
+    }
+    entry->hasSecurity = false;
+    entry->noFastCommands = false;
   }
-#ifdef DEBUG
-  else PN5180DEBUG(F("No IC ref\n"));
-#endif
+  entry->valid = true;
+  entry->extended = extended;
+  entry->info = *info;
+  entry->lastUsed = ++cacheClock;
+}
 
-  return ISO15693_EC_OK;
+// false if the cached memory size of the label ends before the block range
+bool PN5180ISO15693::cachedBlocksAvailable(const uint8_t *uid, uint16_t blockNo, uint16_t numBlock) {
+  ISO15693CacheEntry *entry = findCacheEntry(uid);
+  if ((0L == entry) || (0 == entry->info.numBlocks)) return true; // unknown
+  return (uint32_t(blockNo) + numBlock <= entry->info.numBlocks);
 }
 
+// true if the cached security status has a locked block in the range
+bool PN5180ISO15693::cachedBlocksLocked(const uint8_t *uid, uint16_t blockNo, uint16_t numBlock) {
+  ISO15693CacheEntry *entry = findCacheEntry(uid);
+  if ((0L == entry) || !entry->hasSecurity) return false; // unknown
+  for (uint16_t i=blockNo; (i<blockNo+numBlock) && (i<256); i++) {
+    if (entry->locked[i/8] & (1 << (i%8))) return true;
+  }
+  return false;
+}
 
 // ICODE SLIX specific commands
 
+/*
+ * Switch the receiver between 26 kbit/s (RX config 0x8D) and 53 kbit/s
+ * (0x8E, responses to the fast commands), transmitter unchanged.
+ * loadRFConfig() skips this if the receiver is set already.
+ */
+bool PN5180ISO15693::setFastRx(bool fast) {
+  return loadRFConfig(0xFF, fast ? 0x8E : 0x8D);
+}
+
+/*
+ * FAST READ MULTIPLE BLOCKS, custom code=C3
+ *
+ * Request format: SOF, Req.Flags, FastReadMultipleBlock, IC Mfg code, UID (opt.), FirstBlockNumber,
+ *                 numBlocks-1, CRC16, EOF
+ * Response format: like READ MULTIPLE BLOCKS, but at 53 kbit/s
+ *
+ * If the fast attempt fails, READ MULTIPLE BLOCKS is used. Labels not
+ * supporting the command (no response, or error 01/02) are remembered in
+ * the cache, later calls skip the fast attempt. Other failures, e.g. a CRC
+ * error, are retried fast next time.
+ */
+ISO15693ErrorCode PN5180ISO15693::fastReadMultipleBlock(const uint8_t *uid, uint8_t blockNo, uint8_t numBlock, uint8_t *blockData, uint8_t blockSize) {
+  if ((0 == numBlock) || (uint16_t(blockNo) + numBlock > 256) ||
+      (1 + uint16_t(numBlock) * blockSize > ISO15693_MAX_RESPONSE_LEN)) {
+    return ISO15693_EC_BLOCK_NOT_AVAILABLE;
+  }
+  ISO15693CacheEntry *entry = findCacheEntry(uid);
+  if (entry && entry->noFastCommands) {
+    return readMultipleBlock(uid, blockNo, numBlock, blockData, blockSize);
+  }
+
+  //                 flags, cmd, mfg, uid (opt.), 1stBlock blocksToRead
+  uint8_t fastReadCmd[13];
+  uint8_t cmdLen = customHeader(fastReadCmd, 0xC3, uid);
+  fastReadCmd[cmdLen++] = blockNo;
+  fastReadCmd[cmdLen++] = uint8_t(numBlock-1);
+  PN5180DEBUG_PRINTF("Fast Read Multiple Block #%d-%d, size=%d\n", blockNo, blockNo+numBlock-1, blockSize);
+
+  uint16_t len = numBlock * blockSize;
+  uint8_t *resultPtr;
+  ISO15693ErrorCode rc = issueISO15693Command(fastReadCmd, cmdLen, &resultPtr, 1 + len, true);
+  if ((ISO15693_EC_OK == rc) && (lastResponseLen >= 1 + len)) {
+    memcpy(blockData, &resultPtr[1], len);
+    return ISO15693_EC_OK;
+  }
+
+  PN5180DEBUG(F("*** Fast read failed, using READ MULTIPLE BLOCKS\n"));
+  bool unsupported = (EC_NO_CARD == rc) || (ISO15693_EC_NOT_SUPPORTED == rc) || (ISO15693_EC_NOT_RECOGNIZED == rc);
+  rc = readMultipleBlock(uid, blockNo, numBlock, blockData, blockSize);
+  if ((ISO15693_EC_OK == rc) && unsupported) {
+    entry = findCacheEntry(uid);
+    if (entry) entry->noFastCommands = true;
+  }
+  return rc;
+}
+
+/*
+ * FAST INVENTORY READ, custom code=A1 (NXP ICODE)
+ *
+ * Request format: SOF, Req.Flags, FastInventoryRead, IC Mfg code (04), AFI (opt.), Mask len, Mask value,
+ *                 FirstBlockNumber, numBlocks-1, CRC16, EOF
+ * Response format (Option flag set): SOF, Resp.Flags, UID (part not in mask), BlockData, CRC16, EOF
+ *                                    at 53 kbit/s
+ *
+ * Inventory (1 slot) and read of numBlock blocks in one exchange, the field
+ * must hold one label only. If there is no valid response, it falls back to
+ * INVENTORY and READ MULTIPLE BLOCKS.
+ */
+ISO15693ErrorCode PN5180ISO15693::fastInventoryRead(uint8_t *uid, uint8_t blockNo, uint8_t numBlock, uint8_t *blockData, uint8_t blockSize) {
+  if ((0 == numBlock) || (uint16_t(blockNo) + numBlock > 256) ||
+      (9 + uint16_t(numBlock) * blockSize > ISO15693_MAX_RESPONSE_LEN)) {
+    return ISO15693_EC_BLOCK_NOT_AVAILABLE;
+  }
+  //                          flags,  cmd,  mfg, maskLen, 1stBlock, blocksToRead
+  uint8_t fastInventoryRead[] = { 0x66, 0xA1, 0x04, 0x00, blockNo, uint8_t(numBlock-1) };
+  //                                ||\- inventory flag + high data rate
+  //                                |\-- 1 slot
+  //                                \--- option flag: UID in response
+  PN5180DEBUG_PRINTF("Fast Inventory Read #%d-%d, size=%d\n", blockNo, blockNo+numBlock-1, blockSize);
+
+  uint16_t len = numBlock * blockSize;
+  uint8_t *resultPtr;
+  ISO15693ErrorCode rc = issueISO15693Command(fastInventoryRead, sizeof(fastInventoryRead), &resultPtr, 9 + len, true);
+  if ((ISO15693_EC_OK == rc) && (lastResponseLen >= 9 + len)) {
+    memcpy(uid, &resultPtr[1], 8);
+    memcpy(blockData, &resultPtr[9], len);
+    return ISO15693_EC_OK;
+  }
+
+  PN5180DEBUG(F("*** Fast inventory read failed, using INVENTORY + READ MULTIPLE BLOCKS\n"));
+  rc = getInventory(uid);
+  if (ISO15693_EC_OK != rc) {
+    return rc;
+  }
+  return readMultipleBlock(uid, blockNo, numBlock, blockData, blockSize);
+}
+
 /*
  * The GET RANDOM NUMBER command is required to receive a random number from the label IC. 
  * The passwords that will be transmitted with the SET PASSWORD,ENABLEPRIVACY and DESTROY commands 
@@ -641,6 +2176,86 @@ ISO15693ErrorCode PN5180ISO15693::enablePrivacy(const uint8_t *password, const u
   return issueISO15693Command(setPrivacy, sizeof(setPrivacy), &readBuffer);
 }
 
+/*
+ * Addressed GET RANDOM NUMBER, SET PASSWORD and ENABLE PRIVACY, see above.
+ * The Select flag is used for the label of selectTag().
+ */
+ISO15693ErrorCode PN5180ISO15693::getRandomNumber(const uint8_t *uid, uint8_t *randomData) {
+  //                   flags, cmd, mfg, uid (opt.)
+  uint8_t getrandom[11];
+  uint8_t cmdLen = customHeader(getrandom, 0xB2, uid);
+  uint8_t *readBuffer;
+  ISO15693ErrorCode rc = issueISO15693Command(getrandom, cmdLen, &readBuffer, 3);
+  if (rc == ISO15693_EC_OK) {
+    randomData[0] = readBuffer[1];
+    randomData[1] = readBuffer[2];
+  }
+  return rc;
+}
+
+ISO15693ErrorCode PN5180ISO15693::setPassword(const uint8_t *uid, uint8_t identifier, const uint8_t *password, const uint8_t *random) {
+  //                     flags, cmd, mfg, uid (opt.), pwdId, pwd (XOR random)
+  uint8_t setPassword[16];
+  uint8_t cmdLen = customHeader(setPassword, 0xB3, uid);
+  setPassword[cmdLen++] = identifier;
+  setPassword[cmdLen++] = password[0] ^ random[0];
+  setPassword[cmdLen++] = password[1] ^ random[1];
+  setPassword[cmdLen++] = password[2] ^ random[0];
+  setPassword[cmdLen++] = password[3] ^ random[1];
+  uint8_t *readBuffer;
+  return issueISO15693Command(setPassword, cmdLen, &readBuffer, 1);
+}
+
+ISO15693ErrorCode PN5180ISO15693::enablePrivacy(const uint8_t *uid, const uint8_t *password, const uint8_t *random) {
+  //                    flags, cmd, mfg, uid (opt.), pwd (XOR random)
+  uint8_t setPrivacy[15];
+  uint8_t cmdLen = customHeader(setPrivacy, 0xBA, uid);
+  setPrivacy[cmdLen++] = password[0] ^ random[0];
+  setPrivacy[cmdLen++] = password[1] ^ random[1];
+  setPrivacy[cmdLen++] = password[2] ^ random[0];
+  setPrivacy[cmdLen++] = password[3] ^ random[1];
+  uint8_t *readBuffer;
+  return issueISO15693Command(setPrivacy, cmdLen, &readBuffer, 1);
+}
+
+/*
+ * WRITE PASSWORD, custom code=B4
+ *
+ * Request format: SOF, Req.Flags, WritePassword, IC Mfg code, UID (opt.), PwdIdentifier, Password (4 bytes),
+ *                 CRC16, EOF
+ * Response format: SOF, Resp.Flags, [ErrorCode,] CRC16, EOF
+ *
+ * The current password of the identifier must have been transmitted with
+ * SET PASSWORD before. The new password is sent in plain text.
+ */
+ISO15693ErrorCode PN5180ISO15693::writePassword(const uint8_t *uid, uint8_t identifier, const uint8_t *password) {
+  //                       flags, cmd, mfg, uid (opt.), pwdId, pwd
+  uint8_t writePassword[16];
+  uint8_t cmdLen = customHeader(writePassword, 0xB4, uid);
+  writePassword[cmdLen++] = identifier;
+  for (uint8_t i=0; i<4; i++) {
+    writePassword[cmdLen++] = password[i];
+  }
+  uint8_t *readBuffer;
+  return issueISO15693Command(writePassword, cmdLen, &readBuffer, 1);
+}
+
+/*
+ * LOCK PASSWORD, custom code=B5
+ *
+ * Request format: SOF, Req.Flags, LockPassword, IC Mfg code, UID (opt.), PwdIdentifier, CRC16, EOF
+ * Response format: SOF, Resp.Flags, [ErrorCode,] CRC16, EOF
+ *
+ * Permanent, requires SET PASSWORD of the identifier before.
+ */
+ISO15693ErrorCode PN5180ISO15693::lockPassword(const uint8_t *uid, uint8_t identifier) {
+  //                      flags, cmd, mfg, uid (opt.), pwdId
+  uint8_t lockPassword[12];
+  uint8_t cmdLen = customHeader(lockPassword, 0xB5, uid);
+  lockPassword[cmdLen++] = identifier;
+  uint8_t *readBuffer;
+  return issueISO15693Command(lockPassword, cmdLen, &readBuffer, 1);
+}
 
 // disable privacy mode for ICODE SLIX2 tag with given password
 ISO15693ErrorCode PN5180ISO15693::disablePrivacyMode(const uint8_t *password) {
@@ -720,39 +2335,108 @@ ISO15693ErrorCode PN5180ISO15693::enablePrivacyMode(const uint8_t *password) {
  *    14 = The specific block was not successfully locked.
  *    A0-DF = Custom command error codes
  *
+ *  expectedLen is the length of the response (flags + data, without CRC) and is
+ *  used to compute the reception timeout. 0 = unknown, assume a long response.
+ *  fastRx: the response comes at 53 kbit/s (NXP fast commands).
+ *  Completion is polled on RX_IRQ_STAT, a missing SOF aborts after t1.
+ *
  *  Function return values:
  *    0 = OK
  *   -1 = No card detected
  *   >0 = Error code
  */
-ISO15693ErrorCode PN5180ISO15693::issueISO15693Command(const uint8_t *cmd, uint8_t cmdLen, uint8_t **resultPtr) {
+ISO15693ErrorCode PN5180ISO15693::issueISO15693Command(const uint8_t *cmd, uint8_t cmdLen, uint8_t **resultPtr, uint16_t expectedLen, bool fastRx) {
 #ifdef DEBUG
   PN5180DEBUG(F("Issue Command 0x"));
   PN5180DEBUG(formatHex(cmd[1]));
   PN5180DEBUG("...\n");
 #endif
+  lastResponseLen = 0;
+  setFastRx(fastRx);
 
-  sendData(cmd, cmdLen);
-  delay(10);
+  /*
+   * The timeouts are computed from the frame lengths: request (incl. CRC),
+   * response delay t1, response (flags, data, CRC). Write-alike commands
+   * answer after the EEPROM has been programmed, up to 20ms.
+   */
+  if (expectedLen == 0) expectedLen = ISO15693_DEFAULT_RESP_LEN;
+  uint8_t cmdCode = cmd[1];
+  bool writeAlike = (cmdCode == 0x21) || (cmdCode == 0x22) || (cmdCode == 0x24) ||
+                    ((cmdCode >= 0x27) && (cmdCode <= 0x2A)) ||
+                    (cmdCode == 0x31) || (cmdCode == 0x32) || (cmdCode == 0x34) ||
+                    (cmdCode == 0xB4) || (cmdCode == 0xB5);
+  uint32_t sofTimeoutUs = (cmdLen + 2) * ISO15693_BYTE_US + ISO15693_SOF_EOF_US +
+                          (writeAlike ? ISO15693_WRITE_T1_US : ISO15693_T1_US) + ISO15693_MARGIN_US;
+  uint32_t timeoutUs = sofTimeoutUs + (expectedLen + 3) * ISO15693_BYTE_US + ISO15693_SOF_EOF_US;
 
-  uint32_t irqR = getIRQStatus();
-  if (0 == (irqR & RX_SOF_DET_IRQ_STAT)) {
-    PN5180DEBUG("Didnt detect RX_SOF_DET_IRQ_STAT after sendData");
-	  return EC_NO_CARD;
+  clearIRQStatus(RX_SOF_DET_IRQ_STAT | IDLE_IRQ_STAT | TX_IRQ_STAT | RX_IRQ_STAT);
+  if (!sendData(cmd, cmdLen)) {
+    PN5180DEBUG(F("*** ERROR in sendData!\n"));
+    return ISO15693_EC_UNKNOWN_ERROR;
   }
-  
-  unsigned long startedWaiting = millis();
-  while(!(irqR & RX_IRQ_STAT)) {
-    irqR = getIRQStatus();
-    delay(1);
-    if (millis() - startedWaiting > commandTimeout) {
-      PN5180DEBUG("Didnt detect RX_IRQ_STAT after sendData");
-      return EC_NO_CARD;
-    }
+
+  ISO15693ErrorCode rc = readResponse(resultPtr, sofTimeoutUs, timeoutUs);
+  if ((EC_NO_CARD == rc) && (0x10 == (cmd[0] & 0x14))) {
+    tagSelected = false; // selected label left the field, end the session
   }
-  
+  return rc;
+}
+
+/*
+ * Write-alike command with the option flag set: the label programs its
+ * memory, then waits for an EOF from the reader before it responds.
+ * The EOF-only frame is sent writeEofDelayUs after the end of the request.
+ * Without the option flag, this is issueISO15693Command().
+ * cmd[0] (the request flags) is modified.
+ */
+ISO15693ErrorCode PN5180ISO15693::issueISO15693WriteCommand(uint8_t *cmd, uint8_t cmdLen, uint8_t **resultPtr) {
+  if (!writeOptionFlag) {
+    cmd[0] &= ~0x40;
+    return issueISO15693Command(cmd, cmdLen, resultPtr, 1);
+  }
+  cmd[0] |= 0x40; // option flag
+  lastResponseLen = 0;
+  setFastRx(false);
+
+  clearIRQStatus(RX_SOF_DET_IRQ_STAT | IDLE_IRQ_STAT | TX_IRQ_STAT | RX_IRQ_STAT);
+  if (!sendData(cmd, cmdLen)) {
+    PN5180DEBUG(F("*** ERROR in sendData!\n"));
+    return ISO15693_EC_UNKNOWN_ERROR;
+  }
+  uint32_t txTimeUs = (cmdLen + 2) * ISO15693_BYTE_US + ISO15693_SOF_EOF_US + ISO15693_MARGIN_US;
+  if (!waitForIRQ(TX_IRQ_STAT, txTimeUs)) {
+    return ISO15693_EC_UNKNOWN_ERROR;
+  }
+  unsigned long txDone = micros();
+
+  uint32_t txConfig;
+  readRegister(TX_CONFIG, &txConfig);
+  writeRegisterWithAndMask(TX_CONFIG, 0xFFFFFB3F);                 // Next SEND_DATA will only include EOF
+  while ((micros() - txDone) < writeEofDelayUs);                   // programming time
+  clearIRQStatus(RX_SOF_DET_IRQ_STAT | IDLE_IRQ_STAT | TX_IRQ_STAT | RX_IRQ_STAT);
+  bool sent = sendData(cmd, 0);
+  writeRegister(TX_CONFIG, txConfig);
+  if (!sent) {
+    return ISO15693_EC_UNKNOWN_ERROR;
+  }
+
+  uint32_t sofTimeoutUs = ISO15693_SOF_EOF_US + ISO15693_T1_US + ISO15693_MARGIN_US;
+  ISO15693ErrorCode rc = readResponse(resultPtr, sofTimeoutUs, sofTimeoutUs + 4 * ISO15693_BYTE_US + ISO15693_SOF_EOF_US);
+  if ((EC_NO_CARD == rc) && (cmd[0] & 0x10)) {
+    tagSelected = false; // selected label left the field, end the session
+  }
+  return rc;
+}
+
+/*
+ * Receive the response of a request, see issueISO15693Command()
+ */
+ISO15693ErrorCode PN5180ISO15693::readResponse(uint8_t **resultPtr, uint32_t sofTimeoutUs, uint32_t timeoutUs) {
   uint32_t rxStatus;
-  readRegister(RX_STATUS, &rxStatus);
+  ISO15693ErrorCode rc = waitForResponse(sofTimeoutUs, timeoutUs, &rxStatus);
+  if (ISO15693_EC_OK != rc) {
+    return rc;
+  }
   
   PN5180DEBUG(F("RX-Status="));
   PN5180DEBUG(formatHex(rxStatus));
@@ -768,6 +2452,7 @@ ISO15693ErrorCode PN5180ISO15693::issueISO15693Command(const uint8_t *cmd, uint8
     PN5180DEBUG(F("*** ERROR in readData!\n"));
     return ISO15693_EC_UNKNOWN_ERROR;
   }
+  lastResponseLen = len;
   
 #ifdef DEBUG
   Serial.print("Read=");
@@ -778,13 +2463,6 @@ ISO15693ErrorCode PN5180ISO15693::issueISO15693Command(const uint8_t *cmd, uint8
   Serial.println();
 #endif
 
-  uint32_t irqStatus = getIRQStatus();
-  if (0 == (RX_SOF_DET_IRQ_STAT & irqStatus)) { // no card detected
-    PN5180DEBUG("Didnt detect RX_SOF_DET_IRQ_STAT after readData");
-    clearIRQStatus(TX_IRQ_STAT | IDLE_IRQ_STAT);
-    return EC_NO_CARD;
-  }
-
   uint8_t responseFlags = (*resultPtr)[0];
   if (responseFlags & (1<<0)) { // error flag
     uint8_t errorCode = (*resultPtr)[1];
@@ -811,21 +2489,70 @@ ISO15693ErrorCode PN5180ISO15693::issueISO15693Command(const uint8_t *cmd, uint8
   return ISO15693_EC_OK;
 }
 
-bool PN5180ISO15693::setupRF() {
-  PN5180DEBUG(F("Loading RF-Configuration...\n"));
-  if (loadRFConfig(0x0d, 0x8d)) {  // ISO15693 parameters
-    PN5180DEBUG(F("done.\n"));
+/*
+ * Wait for the end of the reception of a response. IRQ_STATUS and RX_STATUS
+ * are fetched in one READ_REGISTER_MULTIPLE per poll.
+ * Returns EC_NO_CARD if no SOF was detected within sofTimeoutUs, and
+ * ISO15693_EC_UNKNOWN_ERROR if a SOF was detected but the reception did not
+ * end within timeoutUs (both counted from now on), e.g. colliding responses.
+ */
+ISO15693ErrorCode PN5180ISO15693::waitForResponse(uint32_t sofTimeoutUs, uint32_t timeoutUs, uint32_t *rxStatus) {
+  const uint8_t regs[2] = { IRQ_STATUS, RX_STATUS };
+  uint32_t values[2];
+  unsigned long startedWaiting = micros();
+
+  *rxStatus = 0;
+  PN5180DEBUG_OFF;
+  while (true) {
+    if (!readRegisterMultiple(regs, 2, values)) {
+      PN5180DEBUG_ON;
+      return ISO15693_EC_UNKNOWN_ERROR;
+    }
+    if (values[0] & RX_IRQ_STAT) {
+      break;
+    }
+    unsigned long elapsed = micros() - startedWaiting;
+    if ((0 == (values[0] & RX_SOF_DET_IRQ_STAT)) && (elapsed > sofTimeoutUs)) {
+      PN5180DEBUG_ON;
+      PN5180DEBUG("Didnt detect RX_SOF_DET_IRQ_STAT after sendData\n");
+      return EC_NO_CARD;
+    }
+    if (elapsed > timeoutUs) {
+      PN5180DEBUG_ON;
+      PN5180DEBUG("Didnt detect RX_IRQ_STAT after sendData\n");
+      *rxStatus = values[1];
+      return ISO15693_EC_UNKNOWN_ERROR;
+    }
   }
-  else return false;
+  PN5180DEBUG_ON;
+
+  *rxStatus = values[1];
+  return ISO15693_EC_OK;
+}
+
+bool PN5180ISO15693::setupRF() {
+  if (!configureRF()) return false;
 
   PN5180DEBUG(F("Turning ON RF field...\n"));
   if (setRF_on()) {
     PN5180DEBUG(F("done.\n"));
   }
   else return false;
+  // Transceive is set up by sendData() through the RF state tracking
+
+  return true;
+}
 
-  writeRegisterWithAndMask(SYSTEM_CONFIG, 0xfffffff8);  // Idle/StopCom Command
-  writeRegisterWithOrMask(SYSTEM_CONFIG, 0x00000003);   // Transceive Command
+/*
+ * Load the ISO15693 RF configuration without switching the field, e.g.
+ * after another protocol used the PN5180 with the field kept on.
+ */
+bool PN5180ISO15693::configureRF() {
+  PN5180DEBUG(F("Loading RF-Configuration...\n"));
+  if (loadRFConfig(0x0d, 0x8d)) {  // ISO15693 parameters
+    PN5180DEBUG(F("done.\n"));
+  }
+  else return false;
 
   return true;
 }
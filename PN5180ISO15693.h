@@ -36,28 +36,296 @@ enum ISO15693ErrorCode {
   ISO15693_EC_CUSTOM_CMD_ERROR = 0xA0
 };
 
+// One label found by inventory()
+struct ISO15693InventoryResult {
+  uint8_t uid[8];    // LSB first
+  uint8_t dsfid;
+  uint8_t slot;      // time slot of the response
+  uint8_t round;     // inventory round the label was found in, 0=first
+};
+
+// Inventory mask, bits are matched against the UID starting at the LSB
+struct ISO15693InventoryMask {
+  uint64_t value;
+  uint8_t bits;      // 0..64
+  float expected;    // estimated number of labels matching the mask
+};
+
+// Block read within the inventory slots, see inventoryRead()
+struct ISO15693InventoryRead {
+  uint8_t cmd;       // 0xA0 INVENTORY READ, 0xA1 FAST INVENTORY READ
+  uint8_t blockNo;
+  uint8_t numBlock;
+  uint8_t blockSize;
+  uint8_t *data;     // numBlock*blockSize bytes per label, in the order of results
+};
+
+// Population estimator of inventoryAdaptive(), may be tuned by the application
+struct ISO15693InventoryEstimator {
+  float population;      // estimated labels in the field, start value of the next inventory
+  float smoothing;       // weight of the last inventory for population, 0..1
+  float oneSlotMax;      // masks with upto this many expected labels use 1 slot rounds
+  // statistics of the last inventory
+  uint8_t rounds;
+  uint8_t oneSlotRounds;
+  uint16_t emptySlots;
+  uint16_t singleSlots;
+  uint16_t collisionSlots;
+};
+
+// afi parameter of the inventory functions: no AFI field, all labels answer
+#define ISO15693_NO_AFI (-1)
+
+// Result of getSystemInfo()
+struct ISO15693SystemInfo {
+  uint8_t uid[8];              // LSB first
+  uint8_t infoFlags;           // fields present, see getSystemInfo()
+  uint8_t dsfid;
+  uint8_t afi;
+  uint16_t numBlocks;          // 0 = memory size not reported
+  uint8_t blockSize;
+  uint8_t icRef;
+};
+
+// Cached information of one label, see invalidateCache()
+struct ISO15693CacheEntry {
+  bool valid;
+  bool extended;               // info from EXTENDED GET SYSTEM INFO
+  bool hasSecurity;            // locked is valid
+  bool noFastCommands;         // FAST READ MULTIPLE BLOCKS not supported
+  uint32_t lastUsed;
+  ISO15693SystemInfo info;     // info.uid is the key
+  uint8_t locked[32];          // lock bit of block 0..255
+};
+
+// labels in the system info/security status cache, about 56 bytes each
+#ifndef ISO15693_CACHE_SIZE
+#define ISO15693_CACHE_SIZE 4
+#endif
+
+// Called by readTagMemory() for each chunk, offset in bytes from block 0
+typedef void (*ISO15693ReadCallback)(uint16_t offset, const uint8_t *data, uint16_t len);
+
+// Statistics of readTagMemory()
+struct ISO15693ReadStats {
+  uint16_t bytes;
+  uint16_t chunks;             // successful READ MULTIPLE BLOCKS
+  uint16_t retries;            // failed chunks, read again
+  unsigned long timeUs;
+  float bytesPerSecond;
+};
+
+// Statistics of updateTagMemory()
+struct ISO15693UpdateStats {
+  uint16_t blocksSkipped;      // unchanged, not written
+  uint16_t blocksWritten;      // written and verified
+  uint16_t runs;               // ranges of consecutive changed blocks, one writeBlocks() each
+  unsigned long timeUs;
+};
+
+// bytes compared per READ MULTIPLE BLOCKS of updateTagMemory() (stack buffer)
+#ifndef ISO15693_UPDATE_WINDOW
+#define ISO15693_UPDATE_WINDOW 128
+#endif
+
+// attempts per chunk of readTagMemory()
+#ifndef ISO15693_READ_RETRIES
+#define ISO15693_READ_RETRIES 3
+#endif
+// attempts per request of writeBlocks()
+#ifndef ISO15693_WRITE_RETRIES
+#define ISO15693_WRITE_RETRIES 2
+#endif
+
+// Label in the field, maintained by track()
+struct ISO15693TrackedTag {
+  uint8_t uid[8];              // LSB first
+  unsigned long arrived;       // millis() of the arrival
+  unsigned long lastSeen;      // millis() of the last inventory or probe response
+  uint8_t misses;              // probes in a row without response
+};
+
+// Arrival (arrived=true) or departure of a label, timestamp in millis()
+typedef void (*ISO15693TrackCallback)(const ISO15693TrackedTag *tag, bool arrived, unsigned long timestamp);
+
+// new labels resolved per track() call
+#ifndef ISO15693_TRACK_BATCH
+#define ISO15693_TRACK_BATCH 8
+#endif
+// probes without response until a label is reported as departed
+#ifndef ISO15693_TRACK_MISSES
+#define ISO15693_TRACK_MISSES 3
+#endif
+
+// Settings applied by commissionTag() to each new label
+struct ISO15693CommissionTemplate {
+  const uint8_t *image;        // memory content from block 0, NULL = unchanged
+  uint16_t imageSize;          // bytes, a multiple of the block size
+  int16_t afi;                 // ISO15693_NO_AFI = unchanged, marks commissioned labels if dsfid is -1
+  int16_t dsfid;               // -1 = unchanged, else marks commissioned labels
+  bool lockBlocks;             // lock the blocks written from image
+  bool lockAfi;
+  bool lockDsfid;
+  const uint8_t *currentWritePassword;   // for SET PASSWORD (4 bytes), NULL = 00000000
+  const uint8_t *currentPrivacyPassword; // for SET PASSWORD (4 bytes), NULL = 0F0F0F0F
+  const uint8_t *writePassword;   // new write password, NULL = unchanged
+  const uint8_t *privacyPassword; // new privacy password, NULL = unchanged
+  bool lockPasswords;          // lock the passwords written
+  bool enablePrivacy;          // last step, the label is silent afterwards
+};
+
+// Result of commissionTag(), times in micros()
+struct ISO15693CommissionResult {
+  uint8_t uid[8];
+  ISO15693ErrorCode rc;
+  bool skipped;                // DSFID or AFI marker found, nothing written
+  uint16_t blocksWritten;
+  unsigned long memoryUs;      // memory image, incl. block locks
+  unsigned long configUs;      // AFI and DSFID
+  unsigned long passwordUs;
+  unsigned long privacyUs;
+  unsigned long totalUs;
+};
+
+// Called by track() for each label commissioned
+typedef void (*ISO15693CommissionCallback)(const ISO15693CommissionResult *result);
+
+// Statistics since beginCommissioning()
+struct ISO15693CommissionStats {
+  uint16_t commissioned;
+  uint16_t skipped;
+  uint16_t failed;
+  unsigned long startTime;     // millis()
+  float tagsPerMinute;         // commissioned labels
+};
+
+// pending masks of one inventory() call, 13 bytes each
+#ifndef ISO15693_INVENTORY_QUEUE_SIZE
+#define ISO15693_INVENTORY_QUEUE_SIZE 16
+#endif
+
 class PN5180ISO15693 : public PN5180 {
 
 public:
   PN5180ISO15693(uint8_t SSpin, uint8_t BUSYpin, uint8_t RSTpin, SPIClass& spi=SPI);
   
 private:
-  ISO15693ErrorCode issueISO15693Command(const uint8_t *cmd, uint8_t cmdLen, uint8_t **resultPtr);
-  ISO15693ErrorCode inventoryPoll(uint8_t *uid, uint8_t maxTags, uint8_t *numCard, uint8_t *numCol, uint16_t *collision);
+  uint16_t lastResponseLen = 0;
+  ISO15693ErrorCode issueISO15693Command(const uint8_t *cmd, uint8_t cmdLen, uint8_t **resultPtr, uint16_t expectedLen = 0, bool fastRx = false);
+  ISO15693ErrorCode issueISO15693WriteCommand(uint8_t *cmd, uint8_t cmdLen, uint8_t **resultPtr);
+  ISO15693ErrorCode readResponse(uint8_t **resultPtr, uint32_t sofTimeoutUs, uint32_t timeoutUs);
+  ISO15693ErrorCode waitForResponse(uint32_t sofTimeoutUs, uint32_t timeoutUs, uint32_t *rxStatus);
+  bool setFastRx(bool fast);
+  bool writeOptionFlag = false;
+  uint32_t writeEofDelayUs = 20000;
+  // system info/security status cache
+  ISO15693CacheEntry cache[ISO15693_CACHE_SIZE] = {};
+  uint32_t cacheClock = 0;
+  ISO15693CacheEntry *findCacheEntry(const uint8_t *uid);
+  void touchCacheEntry(ISO15693CacheEntry *entry);
+  void storeCacheEntry(const ISO15693SystemInfo *info, bool extended);
+  bool cachedBlocksAvailable(const uint8_t *uid, uint16_t blockNo, uint16_t numBlock);
+  bool cachedBlocksLocked(const uint8_t *uid, uint16_t blockNo, uint16_t numBlock);
+  ISO15693InventoryEstimator estimator = { 1.0f, 0.5f, 3.0f, 0, 0, 0, 0, 0 };
+  ISO15693ErrorCode runInventory(ISO15693InventoryResult *results, uint8_t maxTags, uint8_t *numTags, bool adaptive,
+                                 ISO15693InventoryEstimator *est, const uint8_t *mask, uint8_t maskLen, int16_t afi, const ISO15693InventoryRead *read = 0L);
+  ISO15693ErrorCode inventoryRound(const ISO15693InventoryMask *mask, int16_t afi, uint8_t numSlots, uint8_t round,
+                                   ISO15693InventoryResult *results, uint8_t maxTags, uint8_t *numTags,
+                                   uint16_t *collisionSlots, uint8_t *numResponses, const ISO15693InventoryRead *read);
+  // session, see selectTag()
+  bool tagSelected = false;
+  uint16_t selectedSession = 0;     // RF session of selectTag(), see getRFSession()
+  uint8_t selectedUid[8];
+  uint8_t requestHeader(uint8_t *frame, uint8_t cmd, const uint8_t *uid);
+  // tracking
+  ISO15693TrackedTag *trackedTags = 0L;
+  ISO15693InventoryEstimator trackEstimator = { 1.0f, 0.5f, 3.0f, 0, 0, 0, 0, 0 };
+  uint8_t maxTracked = 0;
+  uint8_t numTracked = 0;
+  ISO15693TrackCallback trackCallback = 0L;
+  unsigned long probeInterval = 0;
+  unsigned long lastProbe = 0;
+  void trackDeparture(uint8_t index, unsigned long now);
+  // commissioning of new labels by track()
+  const ISO15693CommissionTemplate *commissionTemplate = 0L;
+  ISO15693CommissionCallback commissionCallback = 0L;
+  ISO15693CommissionStats commissionStats = { 0, 0, 0, 0, 0.0f };
+  uint8_t customHeader(uint8_t *frame, uint8_t cmd, const uint8_t *uid);
+  ISO15693ErrorCode writeConfigByte(const uint8_t *uid, uint8_t cmd, int16_t value);
+  ISO15693ErrorCode commissionAfi(const uint8_t *uid, const ISO15693CommissionTemplate *tpl);
 public:
   ISO15693ErrorCode getInventory(uint8_t *uid);
+  ISO15693ErrorCode getInventory(uint8_t *uid, const uint8_t *mask, uint8_t maskLen, int16_t afi=ISO15693_NO_AFI);
   ISO15693ErrorCode getInventoryMultiple(uint8_t *uid, uint8_t maxTags, uint8_t *numCard);
+  ISO15693ErrorCode inventory(ISO15693InventoryResult *results, uint8_t maxTags, uint8_t *numTags);
+  ISO15693ErrorCode inventory(ISO15693InventoryResult *results, uint8_t maxTags, uint8_t *numTags,
+                              const uint8_t *mask, uint8_t maskLen, int16_t afi=ISO15693_NO_AFI);
+  ISO15693ErrorCode inventoryAdaptive(ISO15693InventoryResult *results, uint8_t maxTags, uint8_t *numTags);
+  ISO15693ErrorCode inventoryAdaptive(ISO15693InventoryResult *results, uint8_t maxTags, uint8_t *numTags,
+                                      const uint8_t *mask, uint8_t maskLen, int16_t afi=ISO15693_NO_AFI);
+  ISO15693InventoryEstimator *getInventoryEstimator() { return &estimator; }
+  ISO15693ErrorCode inventoryRead(ISO15693InventoryResult *results, uint8_t *blockData, uint8_t maxTags, uint8_t *numTags,
+                                  uint8_t blockNo, uint8_t numBlock, uint8_t blockSize, bool fast=false);
+  ISO15693ErrorCode selectTag(const uint8_t *uid);
+  ISO15693ErrorCode deselectTag();
+  bool isTagSelected() { return tagSelected && (selectedSession == getRFSession()); }
+  ISO15693ErrorCode stayQuiet(const uint8_t *uid);
+  ISO15693ErrorCode resetToReady(const uint8_t *uid);
+  // Continuous tracking with STAY QUIET, see track()
+  void beginTracking(ISO15693TrackedTag *tags, uint8_t maxTags, ISO15693TrackCallback callback, unsigned long probeIntervalMs=1000);
+  ISO15693ErrorCode track();
+  void endTracking();
+  uint8_t getNumTracked() { return numTracked; }
+  const ISO15693TrackedTag *getTrackedTags() { return trackedTags; }
+  // Commissioning of each new label found by track()
+  void beginCommissioning(const ISO15693CommissionTemplate *tpl, ISO15693CommissionCallback callback=NULL);
+  void endCommissioning();
+  const ISO15693CommissionStats *getCommissionStats();
+  ISO15693ErrorCode commissionTag(const uint8_t *uid, uint8_t dsfid, const ISO15693CommissionTemplate *tpl,
+                                  ISO15693CommissionResult *result);
 
   ISO15693ErrorCode readSingleBlock(const uint8_t *uid, uint8_t blockNo, uint8_t *blockData, uint8_t blockSize);
   ISO15693ErrorCode writeSingleBlock(const uint8_t *uid, uint8_t blockNo, const uint8_t *blockData, uint8_t blockSize);
   ISO15693ErrorCode readMultipleBlock(const uint8_t *uid, uint8_t blockNo, uint8_t numBlock, uint8_t *blockData, uint8_t blockSize);
+  ISO15693ErrorCode writeMultipleBlock(const uint8_t *uid, uint8_t blockNo, uint8_t numBlock, const uint8_t *blockData, uint8_t blockSize);
+  ISO15693ErrorCode writeBlocks(const uint8_t *uid, uint8_t blockNo, uint16_t numBlock, const uint8_t *blockData, uint8_t blockSize);
+  void setWriteOption(bool optionFlag, uint32_t eofDelayUs=20000);
+  ISO15693ErrorCode lockBlock(const uint8_t *uid, uint8_t blockNo);
+  ISO15693ErrorCode writeAFI(const uint8_t *uid, uint8_t afi);
+  ISO15693ErrorCode lockAFI(const uint8_t *uid);
+  ISO15693ErrorCode writeDSFID(const uint8_t *uid, uint8_t dsfid);
+  ISO15693ErrorCode lockDSFID(const uint8_t *uid);
 
   ISO15693ErrorCode getSystemInfo(uint8_t *uid, uint8_t *blockSize, uint8_t *numBlocks);
+  ISO15693ErrorCode getSystemInfo(const uint8_t *uid, ISO15693SystemInfo *info);
+  ISO15693ErrorCode getMultipleBlockSecurityStatus(const uint8_t *uid, uint8_t blockNo, uint16_t numBlock, uint8_t *status);
+  ISO15693ErrorCode getBlockLocked(const uint8_t *uid, uint8_t blockNo, bool *locked);
+  void invalidateCache(const uint8_t *uid=NULL);
+  ISO15693ErrorCode readTagMemory(const uint8_t *uid, uint8_t *buffer, uint16_t bufferSize,
+                                  ISO15693ReadCallback callback=NULL, ISO15693ReadStats *stats=NULL);
+  ISO15693ErrorCode updateTagMemory(const uint8_t *uid, const uint8_t *image, uint16_t size,
+                                    uint8_t *current=NULL, ISO15693UpdateStats *stats=NULL);
+
+  // Extended commands, 16 bit block numbers (labels with more than 256 blocks)
+  ISO15693ErrorCode extendedReadSingleBlock(const uint8_t *uid, uint16_t blockNo, uint8_t *blockData, uint8_t blockSize);
+  ISO15693ErrorCode extendedWriteSingleBlock(const uint8_t *uid, uint16_t blockNo, const uint8_t *blockData, uint8_t blockSize);
+  ISO15693ErrorCode extendedReadMultipleBlock(const uint8_t *uid, uint16_t blockNo, uint16_t numBlock, uint8_t *blockData, uint8_t blockSize);
+  ISO15693ErrorCode extendedGetSystemInfo(const uint8_t *uid, ISO15693SystemInfo *info);
    
+  // Fast commands, response at 53 kbit/s, fallback to the standard commands
+  ISO15693ErrorCode fastReadMultipleBlock(const uint8_t *uid, uint8_t blockNo, uint8_t numBlock, uint8_t *blockData, uint8_t blockSize);
+  ISO15693ErrorCode fastInventoryRead(uint8_t *uid, uint8_t blockNo, uint8_t numBlock, uint8_t *blockData, uint8_t blockSize);
+
   // ICODE SLIX2 specific commands, see https://www.nxp.com/docs/en/data-sheet/SL2S2602.pdf
   ISO15693ErrorCode getRandomNumber(uint8_t *randomData);
   ISO15693ErrorCode setPassword(uint8_t identifier, const uint8_t *password, const uint8_t *random);
   ISO15693ErrorCode enablePrivacy(const uint8_t *password, const uint8_t *random);
+  // addressed (or selected) variants, labels in the ready or quiet state
+  ISO15693ErrorCode getRandomNumber(const uint8_t *uid, uint8_t *randomData);
+  ISO15693ErrorCode setPassword(const uint8_t *uid, uint8_t identifier, const uint8_t *password, const uint8_t *random);
+  ISO15693ErrorCode writePassword(const uint8_t *uid, uint8_t identifier, const uint8_t *password);
+  ISO15693ErrorCode lockPassword(const uint8_t *uid, uint8_t identifier);
+  ISO15693ErrorCode enablePrivacy(const uint8_t *uid, const uint8_t *password, const uint8_t *random);
   // helpers
   ISO15693ErrorCode enablePrivacyMode(const uint8_t *password);
   ISO15693ErrorCode disablePrivacyMode(const uint8_t *password);
@@ -66,6 +334,7 @@ public:
    */
 public:   
   bool setupRF();
+  bool configureRF();
   const char *strerror(ISO15693ErrorCode code);
     
 };
@@ -0,0 +1,319 @@
+// NAME: PN5180ISO18000.cpp
+//
+// DESC: ISO18000-3 Mode 3 (EPC HF) protocol on NXP Semiconductors PN5180
+//       module for Arduino.
+//
+// This file is part of the PN5180 library for the Arduino environment.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+//#define DEBUG 1
+
+#include <Arduino.h>
+#include "PN5180ISO18000.h"
+#include "Debug.h"
+
+// upper bound of one timeslot (NextSlot, RN16, ACK, PC/UII/CRC-16 at 106 kbit/s)
+#define ISO18000_SLOT_US          (2000UL)
+#define ISO18000_MARGIN_US        (10000UL)
+// size of the PN5180 inventory result buffer
+#define ISO18000_MAX_RESULT_LEN   (508)
+
+// timeslot status in the inventory result
+#define ISO18000_SLOT_REPLY        (0)
+#define ISO18000_SLOT_REPLY_HANDLE (1)
+#define ISO18000_SLOT_EMPTY        (2)
+#define ISO18000_SLOT_COLLISION    (3)
+
+PN5180ISO18000::PN5180ISO18000(uint8_t SSpin, uint8_t BUSYpin, uint8_t RSTpin, SPIClass& spi)
+              : PN5180(SSpin, BUSYpin, RSTpin, spi) {
+}
+
+/*
+ * Query parameters of the next inventory rounds.
+ * q: 2^q timeslots per round (0..15)
+ * session: S0..S3, target: inventoried flag A (0) or B (1) of the first
+ *          inventory(), it alternates with each call
+ * sel: 0/1 = all tags, 2 = SL flag not set, 3 = SL flag set
+ * adaptiveQ: q is adjusted after each round from the number of empty and
+ *            collision slots
+ */
+void PN5180ISO18000::setQuery(uint8_t q, uint8_t session, uint8_t target, uint8_t sel, bool adaptiveQ) {
+  this->q = (q > 15) ? 15 : q;
+  this->session = session & 0x03;
+  this->target = this->queryTarget = target & 0x01;
+  this->sel = sel & 0x03;
+  this->adaptiveQ = adaptiveQ;
+}
+
+/*
+ * Query, code=1000b
+ *
+ * Command format: Cmd (4), DR (1), M (2), TRext (1), Sel (2), Session (2), Target (1), Q (4), CRC-5
+ * 22 bits, MSB first, left aligned in 3 bytes.
+ */
+void PN5180ISO18000::buildQuery(uint8_t *query) {
+  uint32_t bits = (0x8UL << 13) | ((uint32_t)dr << 12) | ((uint32_t)m << 10) | (0UL << 9) |
+                  ((uint32_t)sel << 7) | ((uint32_t)session << 5) | ((uint32_t)target << 4) | q;
+  // CRC-5: x^5 + x^3 + 1, preset 01001b
+  uint8_t crc = 0x09;
+  for (int8_t i=16; i>=0; i--) {
+    uint8_t bit = (bits >> i) & 0x01;
+    uint8_t msb = (crc >> 4) & 0x01;
+    crc = (crc << 1) & 0x1F;
+    if (bit ^ msb) crc ^= 0x09;
+  }
+  uint32_t frame = ((bits << 5) | crc) << 2;
+  query[0] = uint8_t(frame >> 16);
+  query[1] = uint8_t(frame >> 8);
+  query[2] = uint8_t(frame);
+}
+
+// append n bits of value to frame, MSB first
+static void putBits(uint8_t *frame, uint16_t *pos, uint16_t value, uint8_t n) {
+  for (int8_t i=n-1; i>=0; i--) {
+    if ((value >> i) & 0x01) frame[*pos/8] |= (0x80 >> (*pos%8));
+    *pos = *pos + 1;
+  }
+}
+
+/*
+ * Select, code=1010b, sent before each inventory round (CRC-16 by the PN5180)
+ *
+ * Command format: Cmd (4), Target (3), Action (3), MemBank (2), Pointer (EBV), Length (8),
+ *                 Mask (Length bits), Truncate (1)
+ * mask: maskBits bits, MSB first. pointer: bit address in memBank.
+ * Returns false if the command exceeds 39 bytes.
+ */
+bool PN5180ISO18000::setSelect(uint8_t target, uint8_t action, uint8_t memBank, uint16_t pointer, const uint8_t *mask, uint8_t maskBits,
+                               bool truncate) {
+  uint8_t pointerBits = (pointer < 0x80) ? 8 : 16;
+  uint16_t numBits = 4 + 3 + 3 + 2 + pointerBits + 8 + maskBits + 1;
+  if ((numBits > 39 * 8) || (pointer >= 0x4000)) {
+    PN5180DEBUG(F("*** Select command too long\n"));
+    return false;
+  }
+  memset(selectFrame, 0, sizeof(selectFrame));
+  uint16_t pos = 0;
+  putBits(selectFrame, &pos, 0xA, 4);
+  putBits(selectFrame, &pos, target & 0x07, 3);
+  putBits(selectFrame, &pos, action & 0x07, 3);
+  putBits(selectFrame, &pos, memBank & 0x03, 2);
+  if (pointerBits == 8) {
+    putBits(selectFrame, &pos, pointer, 8);
+  }
+  else {
+    putBits(selectFrame, &pos, 0x80 | (pointer >> 7), 8); // EBV, extension bit set
+    putBits(selectFrame, &pos, pointer & 0x7F, 8);
+  }
+  putBits(selectFrame, &pos, maskBits, 8);
+  for (uint8_t b=0; b<maskBits; b++, pos++) {
+    if ((mask[b/8] << (b%8)) & 0x80) selectFrame[pos/8] |= (0x80 >> (pos%8));
+  }
+  putBits(selectFrame, &pos, truncate ? 1 : 0, 1);
+
+  selectLen = (numBits + 7) / 8;
+  selectValidBits = numBits % 8;
+  return true;
+}
+
+/*
+ * Inventory with EPC_INVENTORY, the PN5180 processes the timeslots.
+ *
+ * Each round sends the Select (if set, see setSelect()) and the Query. The
+ * tag replies are retrieved from the inventory result buffer in bulk
+ * whenever the PN5180 pauses (buffer full or round complete), and the
+ * round is resumed with EPC_RESUME_INVENTORY until all 2^Q timeslots are
+ * processed. Tags read in a round change their inventoried flag, so
+ * further rounds (upto ISO18000_MAX_ROUNDS) resolve the collisions.
+ * The tags keep the flipped flag while the field is on (session S0) or
+ * for the persistence time of S1..S3, so the target is toggled at the end
+ * of each inventory() and the next call reads the same tags back (dual
+ * target inventory). Tags left over by this call are found by the one
+ * after the next. After a field off or reset (see getRFSession()) the S0
+ * flags are back to A, so the target of setQuery() is used again.
+ * Returns ISO18000_EC_OK, also if maxTags tags were found.
+ */
+ISO18000ErrorCode PN5180ISO18000::inventory(ISO18000Tag *tags, uint8_t maxTags, uint8_t *numTags) {
+  PN5180DEBUG_PRINTF("PN5180ISO18000::inventory(maxTags=%d, q=%d)", maxTags, q);
+  PN5180DEBUG_PRINTLN();
+  PN5180DEBUG_ENTER;
+  unsigned long startTime = micros();
+  ISO18000InventoryStats s = { 0, 0, 0, 0, 0, 0, 0.0f };
+  stats = s;
+  *numTags = 0;
+  if ((0 == session) && (inventorySession != getRFSession())) {
+    target = queryTarget;
+  }
+
+  ISO18000ErrorCode rc = ISO18000_EC_OK;
+  while ((stats.rounds < ISO18000_MAX_ROUNDS) && (*numTags < maxTags)) {
+    uint16_t collisions = 0, empties = 0;
+    rc = inventoryRound(tags, maxTags, numTags, &collisions, &empties);
+    if (ISO18000_EC_OK != rc) break;
+    stats.rounds++;
+    stats.collisionSlots += collisions;
+    stats.emptySlots += empties;
+
+    if (adaptiveQ) {
+      uint16_t slots = 1 << q;
+      if ((collisions > slots / 4) && (q < 15)) q++;
+      else if ((empties > slots - slots / 4) && (q > 0)) q--;
+    }
+    if (0 == collisions) break;
+  }
+  if (stats.rounds > 0) {
+    target ^= 0x01;
+    inventorySession = getRFSession();
+  }
+
+  stats.timeUs = micros() - startTime;
+  if (stats.timeUs > 0) {
+    stats.tagsPerSecond = float(*numTags) * 1000000.0f / stats.timeUs;
+  }
+  PN5180DEBUG_PRINTF("*** Found %d tags in %d rounds, %lu us", *numTags, stats.rounds, stats.timeUs);
+  PN5180DEBUG_PRINTLN();
+  PN5180DEBUG_EXIT;
+  return rc;
+}
+
+ISO18000ErrorCode PN5180ISO18000::inventoryRound(ISO18000Tag *tags, uint8_t maxTags, uint8_t *numTags, uint16_t *collisions, uint16_t *empties) {
+  uint8_t query[3];
+  buildQuery(query);
+  uint16_t slots = 1 << q;
+  uint16_t processed = 0;
+
+  clearIRQStatus(IDLE_IRQ_STAT | GENERAL_ERROR_IRQ_STAT | TX_IRQ_STAT | RX_IRQ_STAT);
+  if (!epcInventory(selectLen ? selectFrame : 0L, selectLen, selectValidBits, query, 0)) {
+    return ISO18000_EC_COMMAND_FAILED;
+  }
+
+  while (true) {
+    uint32_t irqStatus;
+    uint32_t timeoutUs = (uint32_t)(slots - processed) * ISO18000_SLOT_US + ISO18000_MARGIN_US;
+    if (!waitForIRQ(IDLE_IRQ_STAT | GENERAL_ERROR_IRQ_STAT, timeoutUs, &irqStatus)) {
+      return ISO18000_EC_TIMEOUT;
+    }
+    if (irqStatus & GENERAL_ERROR_IRQ_STAT) {
+      return ISO18000_EC_COMMAND_FAILED;
+    }
+
+    uint16_t size;
+    if (!epcRetrieveInventoryResultSize(&size)) {
+      return ISO18000_EC_COMMAND_FAILED;
+    }
+    if (size > ISO18000_MAX_RESULT_LEN) size = ISO18000_MAX_RESULT_LEN;
+    uint16_t numSlots = 0;
+    if (size > 0) {
+      uint8_t result[size];
+      if (!epcRetrieveInventoryResult(result, size)) {
+        return ISO18000_EC_COMMAND_FAILED;
+      }
+      if (!parseResult(result, size, tags, maxTags, numTags, &numSlots, collisions, empties)) {
+        return ISO18000_EC_RESULT_FORMAT;
+      }
+    }
+    processed += numSlots;
+    stats.slots += numSlots;
+    if ((processed >= slots) || (0 == numSlots)) break;
+
+    // result buffer was full
+    clearIRQStatus(IDLE_IRQ_STAT | GENERAL_ERROR_IRQ_STAT | TX_IRQ_STAT | RX_IRQ_STAT);
+    if (!epcResumeInventory()) {
+      return ISO18000_EC_COMMAND_FAILED;
+    }
+    stats.resumes++;
+  }
+  return ISO18000_EC_OK;
+}
+
+/*
+ * Parse the inventory result, see PN5180::epcRetrieveInventoryResult().
+ * Tags already found (same UII) are not recorded twice.
+ */
+bool PN5180ISO18000::parseResult(const uint8_t *result, uint16_t len, ISO18000Tag *tags, uint8_t maxTags, uint8_t *numTags,
+                                 uint16_t *numSlots, uint16_t *collisions, uint16_t *empties) {
+  uint16_t pos = 0;
+  while (pos + 2 <= len) {
+    uint8_t replyLen = result[pos];
+    uint8_t status = result[pos+1] >> 4;
+    pos += 2;
+    uint16_t entryLen = replyLen + ((ISO18000_SLOT_REPLY_HANDLE == status) ? 2 : 0);
+    if (pos + entryLen > len) {
+      PN5180DEBUG(F("*** Truncated inventory result\n"));
+      return false;
+    }
+    *numSlots = *numSlots + 1;
+
+    if (ISO18000_SLOT_EMPTY == status) {
+      *empties = *empties + 1;
+    }
+    else if ((ISO18000_SLOT_COLLISION == status) || (replyLen < 4)) {
+      *collisions = *collisions + 1;
+    }
+    else {
+      // PC (2), UII, CRC-16 (2)
+      const uint8_t *reply = &result[pos];
+      uint8_t uiiLength = replyLen - 4;
+      if (uiiLength > ISO18000_MAX_UII) uiiLength = ISO18000_MAX_UII;
+      bool known = false;
+      for (uint8_t i=0; (i<*numTags) && !known; i++) {
+        known = (tags[i].uiiLength == uiiLength) && (0 == memcmp(tags[i].uii, &reply[2], uiiLength));
+      }
+      if (!known && (*numTags < maxTags)) {
+        ISO18000Tag *tag = &tags[*numTags];
+        tag->pc[0] = reply[0];
+        tag->pc[1] = reply[1];
+        memcpy(tag->uii, &reply[2], uiiLength);
+        tag->uiiLength = uiiLength;
+        *numTags = *numTags + 1;
+      }
+    }
+    pos += entryLen;
+  }
+  return true;
+}
+
+/*
+ * RF configuration matching the Query DR and M fields:
+ * TX 0x0F (Tari 18.88us), RX 0x8F..0x92 (Manchester 424/848 kHz, 4/2 periods)
+ */
+bool PN5180ISO18000::setupRF(uint8_t dr, uint8_t m) {
+  this->dr = dr & 0x01;
+  this->m = m & 0x03;
+  uint8_t rxConf = 0x8F;
+  if (ISO18000_M_MANCHESTER_2 == this->m) rxConf += 1;
+  if (ISO18000_DR_848 == this->dr) rxConf += 2;
+
+  PN5180DEBUG(F("Loading RF-Configuration...\n"));
+  if (loadRFConfig(0x0F, rxConf)) {  // ISO18000-3M3 parameters
+    PN5180DEBUG(F("done.\n"));
+  }
+  else return false;
+
+  PN5180DEBUG(F("Turning ON RF field...\n"));
+  if (setRF_on()) {
+    PN5180DEBUG(F("done.\n"));
+  }
+  else return false;
+
+  return true;
+}
+
+const char *PN5180ISO18000::strerror(ISO18000ErrorCode code) {
+  switch (code) {
+    case ISO18000_EC_OK: return ("OK!");
+    case ISO18000_EC_TIMEOUT: return ("Inventory timeout!");
+    case ISO18000_EC_COMMAND_FAILED: return ("PN5180 command failed!");
+    case ISO18000_EC_RESULT_FORMAT: return ("Malformed inventory result!");
+    default: return ("Undefined error code in ISO18000!");
+  }
+}
@@ -0,0 +1,112 @@
+// NAME: PN5180ISO18000.h
+//
+// DESC: ISO18000-3 Mode 3 (EPC HF) protocol on NXP Semiconductors PN5180
+//       module for Arduino.
+//
+// This file is part of the PN5180 library for the Arduino environment.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+#ifndef PN5180ISO18000_H
+#define PN5180ISO18000_H
+
+#include "PN5180.h"
+
+enum ISO18000ErrorCode {
+  ISO18000_EC_OK = 0,
+  ISO18000_EC_TIMEOUT = 1,          // inventory not finished in time
+  ISO18000_EC_COMMAND_FAILED = 2,   // host interface command failed
+  ISO18000_EC_RESULT_FORMAT = 3     // malformed inventory result
+};
+
+// Backscatter link, Query DR and M fields
+#define ISO18000_DR_424          0  // 423.75 kHz subcarrier
+#define ISO18000_DR_848          1  // 847.5 kHz subcarrier
+#define ISO18000_M_MANCHESTER_2  2  // 2 subcarrier periods per bit
+#define ISO18000_M_MANCHESTER_4  3  // 4 subcarrier periods per bit
+
+// Select command, memory banks
+#define ISO18000_MEMBANK_FILETYPE 0
+#define ISO18000_MEMBANK_UII      1
+#define ISO18000_MEMBANK_TID      2
+#define ISO18000_MEMBANK_USER     3
+
+// bytes of the UII (EPC) stored per tag, longer UIIs are truncated
+#ifndef ISO18000_MAX_UII
+#define ISO18000_MAX_UII 16
+#endif
+// inventory rounds per inventory() call while collisions remain
+#ifndef ISO18000_MAX_ROUNDS
+#define ISO18000_MAX_ROUNDS 4
+#endif
+
+// One tag found by inventory()
+struct ISO18000Tag {
+  uint8_t pc[2];                    // StoredPC
+  uint8_t uii[ISO18000_MAX_UII];
+  uint8_t uiiLength;
+};
+
+// Statistics of the last inventory()
+struct ISO18000InventoryStats {
+  uint8_t rounds;
+  uint16_t slots;
+  uint16_t emptySlots;
+  uint16_t collisionSlots;
+  uint16_t resumes;                 // EPC_RESUME_INVENTORY, result buffer was full
+  unsigned long timeUs;
+  float tagsPerSecond;
+};
+
+class PN5180ISO18000 : public PN5180 {
+
+public:
+  PN5180ISO18000(uint8_t SSpin, uint8_t BUSYpin, uint8_t RSTpin, SPIClass& spi=SPI);
+
+private:
+  // Query parameters, see setQuery()
+  uint8_t dr = ISO18000_DR_424;
+  uint8_t m = ISO18000_M_MANCHESTER_4;
+  uint8_t q = 4;
+  uint8_t session = 0;
+  uint8_t target = 0;               // alternates, see inventory()
+  uint8_t queryTarget = 0;          // target of setQuery()
+  uint16_t inventorySession = 0;    // RF session of the last inventory()
+  uint8_t sel = 0;
+  bool adaptiveQ = false;
+  // Select command without CRC-16, see setSelect()
+  uint8_t selectFrame[39];
+  uint8_t selectLen = 0;
+  uint8_t selectValidBits = 0;
+  ISO18000InventoryStats stats = { 0, 0, 0, 0, 0, 0, 0.0f };
+  void buildQuery(uint8_t *query);
+  ISO18000ErrorCode inventoryRound(ISO18000Tag *tags, uint8_t maxTags, uint8_t *numTags, uint16_t *collisions, uint16_t *empties);
+  bool parseResult(const uint8_t *result, uint16_t len, ISO18000Tag *tags, uint8_t maxTags, uint8_t *numTags,
+                   uint16_t *numSlots, uint16_t *collisions, uint16_t *empties);
+
+public:
+  void setQuery(uint8_t q, uint8_t session=0, uint8_t target=0, uint8_t sel=0, bool adaptiveQ=false);
+  bool setSelect(uint8_t target, uint8_t action, uint8_t memBank, uint16_t pointer, const uint8_t *mask, uint8_t maskBits,
+                 bool truncate=false);
+  void clearSelect() { selectLen = 0; }
+  ISO18000ErrorCode inventory(ISO18000Tag *tags, uint8_t maxTags, uint8_t *numTags);
+  const ISO18000InventoryStats *getInventoryStats() { return &stats; }
+  uint8_t getQ() { return q; }
+  uint8_t getTarget() { return target; }
+  /*
+   * Helper functions
+   */
+public:
+  bool setupRF(uint8_t dr=ISO18000_DR_424, uint8_t m=ISO18000_M_MANCHESTER_4);
+  const char *strerror(ISO18000ErrorCode code);
+};
+
+#endif /* PN5180ISO18000_H */
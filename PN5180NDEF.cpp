@@ -0,0 +1,453 @@
+// NAME: PN5180NDEF.cpp
+//
+// DESC: NDEF messages on NFC Forum Type 2 (ISO14443A) and Type 5 (ISO15693)
+//       tags with the NXP Semiconductors PN5180 module for Arduino.
+//
+// This file is part of the PN5180 library for the Arduino environment.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+//#define DEBUG 1
+
+#include <Arduino.h>
+#include "PN5180NDEF.h"
+#include "Debug.h"
+
+// TLV types
+#define NDEF_TLV_NULL        (0x00)
+#define NDEF_TLV_MESSAGE     (0x03)
+#define NDEF_TLV_TERMINATOR  (0xFE)
+
+// NDEF record header flags
+#define NDEF_RECORD_SR       (0x10)
+#define NDEF_RECORD_IL       (0x08)
+#define NDEF_RECORD_TNF_MASK (0x07)
+
+PN5180NDEF::PN5180NDEF(PN5180ISO14443 &nfc) {
+  type2 = &nfc;
+}
+
+PN5180NDEF::PN5180NDEF(PN5180ISO15693 &nfc, const uint8_t *uid) {
+  type5 = &nfc;
+  memcpy(this->uid, uid, 8);
+}
+
+/*
+ * Read the capability container, returns the size of the data area or an
+ * NDEFErrorCode. Called by the read and write functions if needed.
+ *
+ * Type 2, page 3: E1, version, data area size / 8, access (0x00 = read/write)
+ * Type 5, block 0: E1 or E2, version (01xx) and access (write = bits 1..0),
+ *                  data area size / 8 (0: 8 byte CC, size in bytes 6..7),
+ *                  features (bit 0: READ MULTIPLE BLOCKS supported)
+ * The data area follows the CC.
+ */
+int16_t PN5180NDEF::readCC() {
+  PN5180DEBUG_PRINTLN(F("PN5180NDEF::readCC()"));
+  PN5180DEBUG_ENTER;
+  ccValid = false;
+  uint8_t cc[32];
+
+  if (type2) {
+    blockSize = 4;
+    if (!readBlocks(3, 1, cc)) {
+      PN5180DEBUG_EXIT;
+      return NDEF_EC_READ;
+    }
+    if ((0xE1 != cc[0]) || (0x10 != (cc[1] & 0xF0))) {
+      PN5180DEBUG_EXIT;
+      return NDEF_EC_NO_CC;
+    }
+    writable = (0 == (cc[3] & 0x0F));
+    dataStart = 16; // page 4
+    dataSize = cc[2] * 8;
+  }
+  else {
+    ISO15693SystemInfo info;
+    if ((ISO15693_EC_OK == type5->getSystemInfo(uid, &info)) && (0 != info.blockSize)) {
+      blockSize = info.blockSize;
+    }
+    multipleRead = false;
+    if (!readBlocks(0, (blockSize < 8) ? 2 : 1, cc)) {
+      PN5180DEBUG_EXIT;
+      return NDEF_EC_READ;
+    }
+    if (((0xE1 != cc[0]) && (0xE2 != cc[0])) || (0x40 != (cc[1] & 0xC0))) {
+      PN5180DEBUG_EXIT;
+      return NDEF_EC_NO_CC;
+    }
+    writable = (0 == (cc[1] & 0x03));
+    multipleRead = (0 != (cc[3] & 0x01));
+    uint32_t size;
+    if (0 != cc[2]) {
+      dataStart = 4;
+      size = cc[2] * 8;
+    }
+    else {
+      dataStart = 8;
+      size = ((uint32_t(cc[6]) << 8) | cc[7]) * 8;
+    }
+    if (size > 0xFFFFUL - dataStart) size = 0xFFFF - dataStart; // 16 bit addresses
+    dataSize = uint16_t(size);
+  }
+
+  PN5180DEBUG_PRINTF("*** Data area: %d bytes at %d, writable=%d", dataSize, dataStart, writable);
+  PN5180DEBUG_PRINTLN();
+  ccValid = true;
+  PN5180DEBUG_EXIT;
+  return dataSize;
+}
+
+/*
+ * Read the NDEF message (value of the first NDEF TLV) into buffer.
+ * The TLVs are parsed as the blocks arrive; the read stops at the end of
+ * the message, Lock/Memory Control and proprietary TLVs are skipped
+ * without reading them.
+ * Returns the message length or an NDEFErrorCode, NDEF_EC_BUFFER as soon
+ * as the TLV length exceeds bufferSize.
+ */
+int16_t PN5180NDEF::readMessage(uint8_t *buffer, uint16_t bufferSize) {
+  bytesRead = 0;
+  if (!ccValid) {
+    int16_t rc = readCC();
+    if (rc < 0) return rc;
+  }
+  return scan(buffer, bufferSize, 0, 0L, 0, 0L, 0L);
+}
+
+/*
+ * Like readMessage(), but the read stops as soon as the first record with
+ * the given TNF and type (NULL: any type) is complete. record refers to
+ * buffer. Chunked records are returned chunk by chunk.
+ * Returns the number of message bytes read or an NDEFErrorCode,
+ * NDEF_EC_NO_MESSAGE if there is no matching record.
+ */
+int16_t PN5180NDEF::findRecord(uint8_t *buffer, uint16_t bufferSize, uint8_t tnf, const uint8_t *type, uint8_t typeLength,
+                               NDEFRecord *record) {
+  bytesRead = 0;
+  if (!ccValid) {
+    int16_t rc = readCC();
+    if (rc < 0) return rc;
+  }
+  return scan(buffer, bufferSize, tnf, type, typeLength, record, 0L);
+}
+
+/*
+ * Incremental TLV parser, reads the data area in windows of
+ * NDEF_READ_WINDOW bytes.
+ * buffer == NULL: locate only, *tlvOffset is set to the offset (in the data
+ * area) of the first NDEF TLV, or to the first free byte after the other
+ * TLVs if there is none.
+ * record != NULL: stop at the first record matching tnf and type.
+ */
+int16_t PN5180NDEF::scan(uint8_t *buffer, uint16_t bufferSize, uint8_t tnf, const uint8_t *type, uint8_t typeLength,
+                         NDEFRecord *record, uint16_t *tlvOffset) {
+  PN5180DEBUG_PRINTLN(F("PN5180NDEF::scan()"));
+  PN5180DEBUG_ENTER;
+  enum { TLV_T, TLV_L0, TLV_L1, TLV_L2, TLV_V } state = TLV_T;
+  uint8_t tlvType = 0;
+  uint16_t tlvLen = 0;
+  uint16_t tlvStart = 0;
+  uint16_t freeOffset = 0;     // after the last TLV
+  uint16_t copied = 0;
+  uint16_t recordOffset = 0;
+  bool terminator = false;
+
+  uint8_t window[NDEF_READ_WINDOW];
+  uint16_t windowBlocks = NDEF_READ_WINDOW / blockSize;
+  uint16_t addr = dataStart;
+  uint16_t end = dataStart + dataSize;
+  while ((addr < end) && !terminator) {
+    uint16_t block = addr / blockSize;
+    uint16_t numBlock = (end - block * blockSize + blockSize - 1) / blockSize;
+    if (numBlock > windowBlocks) numBlock = windowBlocks;
+    if (!readBlocks(block, numBlock, window)) {
+      PN5180DEBUG_EXIT;
+      return NDEF_EC_READ;
+    }
+    uint16_t windowStart = block * blockSize;
+    uint16_t windowEnd = windowStart + numBlock * blockSize;
+    if (windowEnd > end) windowEnd = end;
+
+    while (addr < windowEnd) {
+      if (TLV_V == state) {
+        // message bytes, rest of the window at once
+        uint16_t n = windowEnd - addr;
+        if (n > tlvLen - copied) n = tlvLen - copied;
+        memcpy(&buffer[copied], &window[addr - windowStart], n);
+        copied += n;
+        addr += n;
+        if (record) {
+          while (parseRecord(buffer, copied, &recordOffset, record)) {
+            if ((record->tnf == tnf) &&
+                ((0L == type) || ((record->typeLength == typeLength) && (0 == memcmp(record->type, type, typeLength))))) {
+              PN5180DEBUG_PRINTF("*** Record found, %d bytes read", bytesRead);
+              PN5180DEBUG_PRINTLN();
+              PN5180DEBUG_EXIT;
+              return copied;
+            }
+          }
+        }
+        if (copied < tlvLen) continue;
+        PN5180DEBUG_EXIT;
+        if (0L == record) return copied;
+        return (recordOffset < copied) ? int16_t(NDEF_EC_FORMAT) : int16_t(NDEF_EC_NO_MESSAGE);
+      }
+
+      uint8_t b = window[addr - windowStart];
+      addr++;
+      if (TLV_T == state) {
+        if (NDEF_TLV_NULL == b) continue;
+        if (NDEF_TLV_TERMINATOR == b) {
+          terminator = true;
+          break;
+        }
+        tlvType = b;
+        tlvStart = addr - 1 - dataStart;
+        state = TLV_L0;
+        continue;
+      }
+      if ((TLV_L0 == state) && (0xFF == b)) {
+        state = TLV_L1;
+        continue;
+      }
+      if (TLV_L1 == state) {
+        tlvLen = uint16_t(b) << 8;
+        state = TLV_L2;
+        continue;
+      }
+      tlvLen = (TLV_L2 == state) ? (tlvLen | b) : b;
+
+      if (NDEF_TLV_MESSAGE != tlvType) {
+        // Lock/Memory Control or proprietary TLV, skip its value
+        addr += tlvLen;
+        freeOffset = addr - dataStart;
+        state = TLV_T;
+        continue;
+      }
+      if (tlvOffset) *tlvOffset = tlvStart;
+      if (0L == buffer) {
+        PN5180DEBUG_EXIT;
+        return 0;
+      }
+      if (tlvLen > bufferSize) {
+        PN5180DEBUG_EXIT;
+        return NDEF_EC_BUFFER;
+      }
+      if (0 == tlvLen) {
+        PN5180DEBUG_EXIT;
+        return record ? NDEF_EC_NO_MESSAGE : 0;
+      }
+      state = TLV_V;
+    }
+  }
+
+  PN5180DEBUG_EXIT;
+  if (TLV_V == state) return NDEF_EC_FORMAT; // TLV exceeds the data area
+  if (tlvOffset) *tlvOffset = (freeOffset > dataSize) ? dataSize : freeOffset;
+  return NDEF_EC_NO_MESSAGE;
+}
+
+/*
+ * Parse the record at *offset of message (len bytes) and advance *offset.
+ * record refers to message, nothing is copied.
+ * Returns false if the record is not complete within len bytes.
+ */
+bool PN5180NDEF::parseRecord(const uint8_t *message, uint16_t len, uint16_t *offset, NDEFRecord *record) {
+  uint32_t pos = *offset;
+  if (pos + 2 > len) return false;
+  uint8_t header = message[pos++];
+  uint8_t typeLength = message[pos++];
+  uint32_t payloadLength;
+  if (header & NDEF_RECORD_SR) {
+    if (pos + 1 > len) return false;
+    payloadLength = message[pos++];
+  }
+  else {
+    if (pos + 4 > len) return false;
+    payloadLength = (uint32_t(message[pos]) << 24) | (uint32_t(message[pos+1]) << 16) |
+                    (uint32_t(message[pos+2]) << 8) | message[pos+3];
+    pos += 4;
+  }
+  uint8_t idLength = 0;
+  if (header & NDEF_RECORD_IL) {
+    if (pos + 1 > len) return false;
+    idLength = message[pos++];
+  }
+  if (pos + typeLength + idLength + payloadLength > len) return false;
+
+  record->header = header;
+  record->tnf = header & NDEF_RECORD_TNF_MASK;
+  record->type = &message[pos];
+  record->typeLength = typeLength;
+  pos += typeLength;
+  record->id = idLength ? &message[pos] : 0L;
+  record->idLength = idLength;
+  pos += idLength;
+  record->payload = &message[pos];
+  record->payloadLength = uint16_t(payloadLength);
+  pos += payloadLength;
+  *offset = uint16_t(pos);
+  return true;
+}
+
+/*
+ * Write message (len bytes) as NDEF TLV, replacing the first NDEF TLV or
+ * after the Lock/Memory Control TLVs of a blank tag, followed by a
+ * terminator TLV if there is room. Only the blocks covered by the new TLV
+ * are read, and only those that differ are written.
+ * Returns the number of blocks written or an NDEFErrorCode.
+ */
+int16_t PN5180NDEF::writeMessage(const uint8_t *message, uint16_t len) {
+  PN5180DEBUG_PRINTF("PN5180NDEF::writeMessage(len=%d)", len);
+  PN5180DEBUG_PRINTLN();
+  PN5180DEBUG_ENTER;
+  bytesRead = 0;
+  if (!ccValid) {
+    int16_t rc = readCC();
+    if (rc < 0) {
+      PN5180DEBUG_EXIT;
+      return rc;
+    }
+  }
+  if (!writable) {
+    PN5180DEBUG_EXIT;
+    return NDEF_EC_READ_ONLY;
+  }
+
+  uint16_t tlvOffset = 0;
+  int16_t rc = scan(0L, 0, 0, 0L, 0, 0L, &tlvOffset);
+  if ((rc < 0) && (NDEF_EC_NO_MESSAGE != rc)) {
+    PN5180DEBUG_EXIT;
+    return rc;
+  }
+
+  //                T, L (1 or 3 bytes)
+  uint8_t header[4] = { NDEF_TLV_MESSAGE };
+  uint8_t hdrLen = 2;
+  if (len < 0xFF) {
+    header[1] = uint8_t(len);
+  }
+  else {
+    header[1] = 0xFF;
+    header[2] = uint8_t(len >> 8);
+    header[3] = uint8_t(len);
+    hdrLen = 4;
+  }
+  uint32_t tlvSize = hdrLen + uint32_t(len);
+  if (tlvOffset + tlvSize > dataSize) {
+    PN5180DEBUG_EXIT;
+    return NDEF_EC_TOO_LARGE;
+  }
+  if (tlvOffset + tlvSize < dataSize) tlvSize++; // terminator TLV
+
+  uint16_t start = dataStart + tlvOffset;
+  uint16_t end = start + uint16_t(tlvSize);
+  uint8_t window[NDEF_READ_WINDOW];
+  uint16_t windowBlocks = NDEF_READ_WINDOW / blockSize;
+  uint16_t written = 0;
+  uint16_t block = start / blockSize;
+  while (block * blockSize < end) {
+    uint16_t numBlock = (end - block * blockSize + blockSize - 1) / blockSize;
+    if (numBlock > windowBlocks) numBlock = windowBlocks;
+    if (!readBlocks(block, numBlock, window)) {
+      PN5180DEBUG_EXIT;
+      return NDEF_EC_READ;
+    }
+    uint8_t image[NDEF_READ_WINDOW];
+    memcpy(image, window, numBlock * blockSize);
+    uint16_t windowStart = block * blockSize;
+    for (uint16_t addr = (start > windowStart) ? start : windowStart; (addr < end) && (addr < windowStart + numBlock * blockSize); addr++) {
+      uint16_t i = addr - start;
+      uint8_t b;
+      if (i < hdrLen) b = header[i];
+      else if (i < hdrLen + len) b = message[i - hdrLen];
+      else b = NDEF_TLV_TERMINATOR;
+      image[addr - windowStart] = b;
+    }
+
+    uint16_t i = 0;
+    while (i < numBlock) {
+      if (0 == memcmp(&image[i * blockSize], &window[i * blockSize], blockSize)) {
+        i++;
+        continue;
+      }
+      uint16_t runStart = i;
+      while ((i < numBlock) && (0 != memcmp(&image[i * blockSize], &window[i * blockSize], blockSize))) {
+        i++;
+      }
+      if (!writeBlocks(block + runStart, i - runStart, &image[runStart * blockSize])) {
+        PN5180DEBUG_EXIT;
+        return NDEF_EC_WRITE;
+      }
+      written += i - runStart;
+    }
+    block += numBlock;
+  }
+
+  PN5180DEBUG_PRINTF("*** %d blocks written", written);
+  PN5180DEBUG_PRINTLN();
+  PN5180DEBUG_EXIT;
+  return written;
+}
+
+/*
+ * Type 2: FAST_READ/READ, see PN5180ISO14443::type2ReadPages()
+ * Type 5: READ MULTIPLE BLOCKS if the CC reports support, else READ SINGLE
+ *         BLOCK; extended commands for blocks beyond 255
+ */
+bool PN5180NDEF::readBlocks(uint16_t blockNo, uint16_t numBlock, uint8_t *data) {
+  bool ok = true;
+  if (type2) {
+    ok = type2->type2ReadPages(uint8_t(blockNo), numBlock, data);
+  }
+  else if (!multipleRead) {
+    for (uint16_t i=0; (i<numBlock) && ok; i++) {
+      uint16_t block = blockNo + i;
+      ISO15693ErrorCode rc = (block < 256) ?
+        type5->readSingleBlock(uid, uint8_t(block), &data[i * blockSize], blockSize) :
+        type5->extendedReadSingleBlock(uid, block, &data[i * blockSize], blockSize);
+      ok = (ISO15693_EC_OK == rc);
+    }
+  }
+  else if (blockNo + numBlock <= 256) {
+    ok = (ISO15693_EC_OK == type5->readMultipleBlock(uid, uint8_t(blockNo), uint8_t(numBlock), data, blockSize));
+  }
+  else {
+    ok = (ISO15693_EC_OK == type5->extendedReadMultipleBlock(uid, blockNo, numBlock, data, blockSize));
+  }
+  if (ok) bytesRead += numBlock * blockSize;
+  return ok;
+}
+
+/*
+ * Type 2: WRITE per page, see PN5180ISO14443::writeBlocks()
+ * Type 5: PN5180ISO15693::writeBlocks(), extended commands beyond block 255
+ */
+bool PN5180NDEF::writeBlocks(uint16_t blockNo, uint16_t numBlock, const uint8_t *data) {
+  if (type2) {
+    uint8_t pages[numBlock];
+    uint8_t status[numBlock];
+    for (uint16_t i=0; i<numBlock; i++) {
+      pages[i] = uint8_t(blockNo + i);
+    }
+    return (numBlock == type2->writeBlocks(pages, data, uint8_t(numBlock), blockSize, status));
+  }
+  if (blockNo + numBlock <= 256) {
+    return (ISO15693_EC_OK == type5->writeBlocks(uid, uint8_t(blockNo), numBlock, data, blockSize));
+  }
+  for (uint16_t i=0; i<numBlock; i++) {
+    if (ISO15693_EC_OK != type5->extendedWriteSingleBlock(uid, blockNo + i, &data[i * blockSize], blockSize)) {
+      return false;
+    }
+  }
+  return true;
+}
@@ -0,0 +1,95 @@
+// NAME: PN5180NDEF.h
+//
+// DESC: NDEF messages on NFC Forum Type 2 (ISO14443A) and Type 5 (ISO15693)
+//       tags with the NXP Semiconductors PN5180 module for Arduino.
+//
+// This file is part of the PN5180 library for the Arduino environment.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+#ifndef PN5180NDEF_H
+#define PN5180NDEF_H
+
+#include "PN5180ISO14443.h"
+#include "PN5180ISO15693.h"
+
+// Negative return values of the PN5180NDEF functions
+enum NDEFErrorCode {
+  NDEF_EC_NO_CC = -1,          // no NDEF capability container
+  NDEF_EC_READ = -2,
+  NDEF_EC_WRITE = -3,
+  NDEF_EC_NO_MESSAGE = -4,     // no NDEF TLV or no matching record
+  NDEF_EC_BUFFER = -5,         // message larger than the buffer
+  NDEF_EC_FORMAT = -6,         // malformed TLV or record
+  NDEF_EC_READ_ONLY = -7,
+  NDEF_EC_TOO_LARGE = -8       // message larger than the data area
+};
+
+// Type Name Format of NDEFRecord.tnf
+#define NDEF_TNF_EMPTY         0x00
+#define NDEF_TNF_WELL_KNOWN    0x01
+#define NDEF_TNF_MEDIA         0x02
+#define NDEF_TNF_ABSOLUTE_URI  0x03
+#define NDEF_TNF_EXTERNAL      0x04
+
+// One record, the pointers refer to the caller's message buffer
+struct NDEFRecord {
+  uint8_t header;              // MB, ME, CF, SR, IL flags and TNF
+  uint8_t tnf;
+  const uint8_t *type;
+  uint8_t typeLength;
+  const uint8_t *id;           // NULL if not present
+  uint8_t idLength;
+  const uint8_t *payload;
+  uint16_t payloadLength;
+};
+
+// bytes read from the tag per request, a multiple of the block size
+#ifndef NDEF_READ_WINDOW
+#define NDEF_READ_WINDOW 32
+#endif
+
+class PN5180NDEF {
+
+public:
+  PN5180NDEF(PN5180ISO14443 &nfc);                       // Type 2, card activated by activateTypeA()
+  PN5180NDEF(PN5180ISO15693 &nfc, const uint8_t *uid);   // Type 5
+
+private:
+  PN5180ISO14443 *type2 = 0L;
+  PN5180ISO15693 *type5 = 0L;
+  uint8_t uid[8];
+  // capability container, see readCC()
+  bool ccValid = false;
+  bool writable = false;
+  bool multipleRead = true;    // Type 5: READ MULTIPLE BLOCKS supported
+  uint8_t blockSize = 4;
+  uint16_t dataStart = 0;      // byte address of the data area
+  uint16_t dataSize = 0;
+  uint16_t bytesRead = 0;
+  bool readBlocks(uint16_t blockNo, uint16_t numBlock, uint8_t *data);
+  bool writeBlocks(uint16_t blockNo, uint16_t numBlock, const uint8_t *data);
+  int16_t scan(uint8_t *buffer, uint16_t bufferSize, uint8_t tnf, const uint8_t *type, uint8_t typeLength,
+               NDEFRecord *record, uint16_t *tlvOffset);
+
+public:
+  int16_t readCC();
+  bool isWritable() { return writable; }
+  uint16_t getDataSize() { return dataSize; }
+  int16_t readMessage(uint8_t *buffer, uint16_t bufferSize);
+  int16_t findRecord(uint8_t *buffer, uint16_t bufferSize, uint8_t tnf, const uint8_t *type, uint8_t typeLength,
+                     NDEFRecord *record);
+  int16_t writeMessage(const uint8_t *message, uint16_t len);
+  uint16_t getBytesRead() { return bytesRead; }
+  static bool parseRecord(const uint8_t *message, uint16_t len, uint16_t *offset, NDEFRecord *record);
+};
+
+#endif /* PN5180NDEF_H */
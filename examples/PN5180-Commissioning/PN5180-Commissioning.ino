@@ -0,0 +1,110 @@
+// NAME: PN5180-Commissioning.ino
+//
+// DESC: Commissions ICODE SLIX2 labels as they enter the field: writes a
+//       memory image, the AFI and a DSFID marker, then prints the time of
+//       each step and the commissioning rate in labels per minute.
+//       Labels carrying the DSFID marker are skipped.
+//
+// This file is part of the PN5180 library for the Arduino environment.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// BEWARE: SPI with an Arduino to a PN5180 module has to be at a level of 3.3V
+// use of logic-level converters from 5V->3.3V is absolutely necessary
+// on most Arduinos for all input pins of PN5180!
+// If used with an ESP-32, there is no need for a logic-level converter, since
+// it operates on 3.3V already.
+//
+
+#include <PN5180.h>
+#include <PN5180ISO15693.h>
+
+#if defined(ARDUINO_AVR_UNO) || defined(ARDUINO_AVR_MEGA2560) || defined(ARDUINO_AVR_NANO)
+
+#define PN5180_NSS  10
+#define PN5180_BUSY 9
+#define PN5180_RST  7
+
+#elif defined(ARDUINO_ARCH_ESP32)
+
+#define PN5180_NSS  16
+#define PN5180_BUSY 5
+#define PN5180_RST  17
+
+#else
+#error Please define your pinout here!
+#endif
+
+PN5180ISO15693 nfc(PN5180_NSS, PN5180_BUSY, PN5180_RST);
+
+// product code in blocks 0-3
+const uint8_t image[16] = {
+  'P', 'N', '5', '1', '8', '0', '-', 'D', 'E', 'M', 'O', 0x00, 0x00, 0x00, 0x01, 0x00
+};
+
+// no locks, no passwords: the labels can be reused for this demo
+const ISO15693CommissionTemplate commission = {
+  image, sizeof(image),
+  0x42,       // AFI
+  0xC5,       // DSFID, marks commissioned labels
+  false, false, false,
+  NULL, NULL,  // current passwords, factory defaults
+  NULL, NULL, false,
+  false       // privacy mode
+};
+
+ISO15693TrackedTag tags[16];
+
+void commissioned(const ISO15693CommissionResult *result) {
+  for (int i=7; i>=0; i--) {
+    if (result->uid[i] < 0x10) Serial.print('0');
+    Serial.print(result->uid[i], HEX);
+  }
+  if (result->skipped) {
+    Serial.println(F(": already commissioned"));
+    return;
+  }
+  if (ISO15693_EC_OK != result->rc) {
+    Serial.print(F(": "));
+    Serial.println(nfc.strerror(result->rc));
+    return;
+  }
+  Serial.print(F(": "));
+  Serial.print(result->blocksWritten);
+  Serial.print(F(" blocks, memory "));
+  Serial.print(result->memoryUs);
+  Serial.print(F(" us, AFI/DSFID "));
+  Serial.print(result->configUs);
+  Serial.print(F(" us, passwords "));
+  Serial.print(result->passwordUs);
+  Serial.print(F(" us, total "));
+  Serial.print(result->totalUs);
+  Serial.print(F(" us, "));
+  Serial.print(nfc.getCommissionStats()->tagsPerMinute);
+  Serial.println(F(" labels/min"));
+}
+
+void setup() {
+  Serial.begin(115200);
+  Serial.println(F("=================================="));
+  Serial.println(F("Uploaded: " __DATE__ " " __TIME__));
+  Serial.println(F("PN5180 ISO15693 Commissioning"));
+
+  nfc.begin();
+  nfc.reset();
+  nfc.setupRF();
+  nfc.beginTracking(tags, 16, NULL);
+  nfc.beginCommissioning(&commission, commissioned);
+}
+
+void loop() {
+  nfc.track();
+}
@@ -0,0 +1,97 @@
+// NAME: PN5180-Discovery.ino
+//
+// DESC: Polls ISO14443A, ISO14443B, FeliCa and ISO15693 cards with one
+//       PN5180Discovery object. The field stays on, only the RF
+//       configuration is changed between the technologies, and the time
+//       spent per technology is printed for each cycle.
+//
+// This file is part of the PN5180 library for the Arduino environment.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// BEWARE: SPI with an Arduino to a PN5180 module has to be at a level of 3.3V
+// use of logic-level converters from 5V->3.3V is absolutely necessary
+// on most Arduinos for all input pins of PN5180!
+// If used with an ESP-32, there is no need for a logic-level converter, since
+// it operates on 3.3V already.
+//
+
+#include <PN5180.h>
+#include <PN5180Discovery.h>
+
+#if defined(ARDUINO_AVR_UNO) || defined(ARDUINO_AVR_MEGA2560) || defined(ARDUINO_AVR_NANO)
+
+#define PN5180_NSS  10
+#define PN5180_BUSY 9
+#define PN5180_RST  7
+
+#elif defined(ARDUINO_ARCH_ESP32)
+
+#define PN5180_NSS  16
+#define PN5180_BUSY 5
+#define PN5180_RST  17
+
+#else
+#error Please define your pinout here!
+#endif
+
+
+PN5180Discovery nfc(PN5180_NSS, PN5180_BUSY, PN5180_RST);
+
+// polling order, e.g. the most frequent technology first
+const PN5180Technology technologies[] = {
+  PN5180_TECH_ISO14443A, PN5180_TECH_ISO15693, PN5180_TECH_ISO14443B, PN5180_TECH_FELICA
+};
+
+void setup() {
+  Serial.begin(115200);
+  Serial.println(F("=================================="));
+  Serial.println(F("Uploaded: " __DATE__ " " __TIME__));
+  Serial.println(F("PN5180 multi-protocol discovery"));
+
+  nfc.begin();
+  nfc.reset();
+  nfc.setupRF();
+  nfc.setTechnologies(technologies, sizeof(technologies) / sizeof(technologies[0]));
+}
+
+void loop() {
+  PN5180DiscoveryResult result;
+  PN5180Technology tech = nfc.discover(&result);
+
+  const PN5180DiscoveryStats *stats = nfc.getStats();
+  for (int i=0; i<PN5180_NUM_TECH; i++) {
+    if (0 == stats->techUs[i]) continue;
+    Serial.print(PN5180Discovery::techName((PN5180Technology)i));
+    Serial.print(F(": "));
+    Serial.print(stats->techUs[i]);
+    Serial.print(F(" us, "));
+  }
+  Serial.print(F("cycle: "));
+  Serial.print(stats->cycleUs);
+  Serial.println(F(" us"));
+
+  if (PN5180_TECH_NONE == tech) {
+    delay(100);
+    return;
+  }
+  Serial.print(PN5180Discovery::techName(tech));
+  Serial.print(F(" card found"));
+  if (result.idLength > 0) {
+    Serial.print(F(", ID="));
+    for (int i=0; i<result.idLength; i++) {
+      if (result.id[i] < 0x10) Serial.print('0');
+      Serial.print(result.id[i], HEX);
+    }
+  }
+  Serial.println();
+  delay(1000);
+}
@@ -0,0 +1,102 @@
+// NAME: PN5180-EPCInventory.ino
+//
+// DESC: Inventory of ISO18000-3 Mode 3 (EPC HF) tags. The timeslots are
+//       processed by the PN5180, Q is adapted to the tag population and the
+//       UIIs are printed along with the inventory statistics. Two
+//       inventories are run back to back, the second one with the other
+//       target flag, both have to find the same tags.
+//
+// This file is part of the PN5180 library for the Arduino environment.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// BEWARE: SPI with an Arduino to a PN5180 module has to be at a level of 3.3V
+// use of logic-level converters from 5V->3.3V is absolutely necessary
+// on most Arduinos for all input pins of PN5180!
+// If used with an ESP-32, there is no need for a logic-level converter, since
+// it operates on 3.3V already.
+//
+
+#include <PN5180.h>
+#include <PN5180ISO18000.h>
+
+#if defined(ARDUINO_AVR_UNO) || defined(ARDUINO_AVR_MEGA2560) || defined(ARDUINO_AVR_NANO)
+
+#define PN5180_NSS  10
+#define PN5180_BUSY 9
+#define PN5180_RST  7
+
+#elif defined(ARDUINO_ARCH_ESP32)
+
+#define PN5180_NSS  16
+#define PN5180_BUSY 5
+#define PN5180_RST  17
+
+#else
+#error Please define your pinout here!
+#endif
+
+#define MAX_TAGS 16
+
+PN5180ISO18000 nfc(PN5180_NSS, PN5180_BUSY, PN5180_RST);
+
+ISO18000Tag tags[MAX_TAGS];
+
+void setup() {
+  Serial.begin(115200);
+  Serial.println(F("=================================="));
+  Serial.println(F("Uploaded: " __DATE__ " " __TIME__));
+  Serial.println(F("PN5180 EPC HF inventory"));
+
+  nfc.begin();
+  nfc.reset();
+  nfc.setupRF(ISO18000_DR_424, ISO18000_M_MANCHESTER_4);
+  // 16 timeslots to start with, session S0, adaptive Q
+  nfc.setQuery(4, 0, 0, 0, true);
+}
+
+void loop() {
+  for (int pass=0; pass<2; pass++) {
+    uint8_t target = nfc.getTarget();
+    uint8_t numTags = 0;
+    ISO18000ErrorCode rc = nfc.inventory(tags, MAX_TAGS, &numTags);
+    if (ISO18000_EC_OK != rc) {
+      Serial.print(F("Inventory failed: "));
+      Serial.println(nfc.strerror(rc));
+      delay(1000);
+      return;
+    }
+
+    for (int i=0; i<numTags; i++) {
+      Serial.print(F("UII: "));
+      for (int j=0; j<tags[i].uiiLength; j++) {
+        if (tags[i].uii[j] < 0x10) Serial.print('0');
+        Serial.print(tags[i].uii[j], HEX);
+      }
+      Serial.println();
+    }
+
+    const ISO18000InventoryStats *stats = nfc.getInventoryStats();
+    Serial.print(F("Target "));
+    Serial.print(target ? 'B' : 'A');
+    Serial.print(F(": "));
+    Serial.print(numTags);
+    Serial.print(F(" tags, "));
+    Serial.print(stats->rounds);
+    Serial.print(F(" rounds, "));
+    Serial.print(stats->collisionSlots);
+    Serial.print(F(" collisions, "));
+    Serial.print(stats->timeUs);
+    Serial.print(F(" us, Q="));
+    Serial.println(nfc.getQ());
+  }
+  delay(1000);
+}
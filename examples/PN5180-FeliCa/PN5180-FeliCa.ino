@@ -0,0 +1,116 @@
+// NAME: PN5180-FeliCa.ino
+//
+// DESC: Polls FeliCa cards with 4 timeslots per SENSF_REQ at 424 kbit/s
+//       (falling back to 212 kbit/s) and reads the first blocks of the
+//       service 0x000B (read-only, e.g. FeliCa Lite-S) of each card.
+//
+// This file is part of the PN5180 library for the Arduino environment.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// BEWARE: SPI with an Arduino to a PN5180 module has to be at a level of 3.3V
+// use of logic-level converters from 5V->3.3V is absolutely necessary
+// on most Arduinos for all input pins of PN5180!
+// If used with an ESP-32, there is no need for a logic-level converter, since
+// it operates on 3.3V already.
+//
+
+#include <PN5180.h>
+#include <PN5180FeliCa.h>
+
+#if defined(ARDUINO_AVR_UNO) || defined(ARDUINO_AVR_MEGA2560) || defined(ARDUINO_AVR_NANO)
+
+#define PN5180_NSS  10
+#define PN5180_BUSY 9
+#define PN5180_RST  7
+
+#elif defined(ARDUINO_ARCH_ESP32)
+
+#define PN5180_NSS  16
+#define PN5180_BUSY 5
+#define PN5180_RST  17
+
+#else
+#error Please define your pinout here!
+#endif
+
+#define MAX_CARDS   4
+#define NUM_BLOCKS  4
+
+PN5180FeliCa nfc(PN5180_NSS, PN5180_BUSY, PN5180_RST);
+
+FeliCaCard cards[MAX_CARDS];
+
+void setup() {
+  Serial.begin(115200);
+  Serial.println(F("=================================="));
+  Serial.println(F("Uploaded: " __DATE__ " " __TIME__));
+  Serial.println(F("PN5180 FeliCa"));
+
+  nfc.begin();
+  nfc.reset();
+  nfc.setupRF(FELICA_BR_424);
+}
+
+void loop() {
+  uint8_t numCards = 0;
+  FeliCaErrorCode rc = nfc.poll(cards, MAX_CARDS, &numCards, FELICA_SYSTEM_CODE_ANY, 4);
+  if (0 == numCards) {
+    if (FELICA_EC_NO_CARD != rc) {
+      Serial.print(F("Polling failed: "));
+      Serial.println(nfc.strerror(rc));
+    }
+    delay(500);
+    return;
+  }
+  const FeliCaPollStats *stats = nfc.getPollStats();
+  Serial.print(numCards);
+  Serial.print(F(" card(s), "));
+  Serial.print(stats->requests);
+  Serial.print(F(" request(s), "));
+  Serial.print(stats->timeUs);
+  Serial.print(F(" us, "));
+  Serial.print((FELICA_BR_424 == nfc.getBitRate()) ? 424 : 212);
+  Serial.println(F(" kbit/s"));
+
+  for (int i=0; i<numCards; i++) {
+    Serial.print(F("IDm: "));
+    for (int j=0; j<8; j++) {
+      if (cards[i].idm[j] < 0x10) Serial.print('0');
+      Serial.print(cards[i].idm[j], HEX);
+    }
+    Serial.print(F(", system code: "));
+    Serial.println(cards[i].systemCode, HEX);
+
+    uint8_t data[NUM_BLOCKS * FELICA_BLOCK_SIZE];
+    uint8_t status[2];
+    rc = nfc.readWithoutEncryption(&cards[i], 0x000B, 0, NUM_BLOCKS, data, status);
+    if (FELICA_EC_OK != rc) {
+      Serial.print(F("Read failed: "));
+      Serial.print(nfc.strerror(rc));
+      Serial.print(F(" status="));
+      Serial.print(status[0], HEX);
+      Serial.print(' ');
+      Serial.println(status[1], HEX);
+      continue;
+    }
+    for (int b=0; b<NUM_BLOCKS; b++) {
+      for (int j=0; j<FELICA_BLOCK_SIZE; j++) {
+        uint8_t v = data[b * FELICA_BLOCK_SIZE + j];
+        if (v < 0x10) Serial.print('0');
+        Serial.print(v, HEX);
+        Serial.print(' ');
+      }
+      Serial.println();
+    }
+  }
+  delay(1000);
+}
@@ -0,0 +1,111 @@
+// NAME: PN5180-ISO14443B.ino
+//
+// DESC: Detects ISO14443 Type B cards with slotted anticollision, selects
+//       each card with ATTRIB at the highest common bit rate and halts it.
+//       The timings of each step are printed.
+//
+// This file is part of the PN5180 library for the Arduino environment.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// BEWARE: SPI with an Arduino to a PN5180 module has to be at a level of 3.3V
+// use of logic-level converters from 5V->3.3V is absolutely necessary
+// on most Arduinos for all input pins of PN5180!
+// If used with an ESP-32, there is no need for a logic-level converter, since
+// it operates on 3.3V already.
+//
+
+#include <PN5180.h>
+#include <PN5180ISO14443B.h>
+
+#if defined(ARDUINO_AVR_UNO) || defined(ARDUINO_AVR_MEGA2560) || defined(ARDUINO_AVR_NANO)
+
+#define PN5180_NSS  10
+#define PN5180_BUSY 9
+#define PN5180_RST  7
+
+#elif defined(ARDUINO_ARCH_ESP32)
+
+#define PN5180_NSS  16
+#define PN5180_BUSY 5
+#define PN5180_RST  17
+
+#else
+#error Please define your pinout here!
+#endif
+
+#define MAX_CARDS 4
+
+PN5180ISO14443B nfc(PN5180_NSS, PN5180_BUSY, PN5180_RST);
+
+ISO14443BCard cards[MAX_CARDS];
+
+void setup() {
+  Serial.begin(115200);
+  Serial.println(F("=================================="));
+  Serial.println(F("Uploaded: " __DATE__ " " __TIME__));
+  Serial.println(F("PN5180 ISO14443 Type B"));
+
+  nfc.begin();
+  nfc.reset();
+  nfc.setupRF();
+}
+
+void loop() {
+  uint8_t numCards = 0;
+  // WUPB with 4 slots, halted cards are woken up again
+  ISO14443BErrorCode rc = nfc.requestB(cards, MAX_CARDS, &numCards, 4, true);
+  if (0 == numCards) {
+    if (ISO14443B_EC_NO_CARD != rc) {
+      Serial.print(F("Request failed: "));
+      Serial.println(nfc.strerror(rc));
+    }
+    delay(500);
+    return;
+  }
+  const ISO14443BTimings *t = nfc.getTimings();
+  Serial.print(numCards);
+  Serial.print(F(" card(s), "));
+  Serial.print(t->rounds);
+  Serial.print(F(" round(s), "));
+  Serial.print(t->requestUs);
+  Serial.println(F(" us"));
+
+  for (int i=0; i<numCards; i++) {
+    Serial.print(F("PUPI: "));
+    for (int j=0; j<4; j++) {
+      if (cards[i].pupi[j] < 0x10) Serial.print('0');
+      Serial.print(cards[i].pupi[j], HEX);
+    }
+    Serial.print(F(", FSC="));
+    Serial.print(cards[i].maxFrameSize);
+
+    rc = nfc.attrib(&cards[i]);
+    if (ISO14443B_EC_OK != rc) {
+      Serial.print(F(", ATTRIB failed: "));
+      Serial.println(nfc.strerror(rc));
+      continue;
+    }
+    Serial.print(F(", ATTRIB "));
+    Serial.print(t->attribUs);
+    Serial.print(F(" us, "));
+    Serial.print(106 << nfc.getBitRatePcd());
+    Serial.print('/');
+    Serial.print(106 << nfc.getBitRatePicc());
+    Serial.print(F(" kbit/s"));
+
+    nfc.haltB(&cards[i]);
+    Serial.print(F(", HLTB "));
+    Serial.print(t->haltUs);
+    Serial.println(F(" us"));
+  }
+  delay(1000);
+}
@@ -0,0 +1,131 @@
+// NAME: PN5180-InventoryBenchmark.ino
+//
+// DESC: Measures the ISO15693 inventory throughput (labels/s) of the
+//       PN5180ISO15693::inventory() anticollision engine for the
+//       population currently in the field.
+//
+// This file is part of the PN5180 library for the Arduino environment.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// BEWARE: SPI with an Arduino to a PN5180 module has to be at a level of 3.3V
+// use of logic-level converters from 5V->3.3V is absolutely necessary
+// on most Arduinos for all input pins of PN5180!
+// If used with an ESP-32, there is no need for a logic-level converter, since
+// it operates on 3.3V already.
+//
+// Usage: put a number of labels on the antenna, the sketch prints one line
+// per population size seen:
+//   labels, inventories, avg. rounds to last label, avg. time [ms], labels/s
+//
+
+#include <PN5180.h>
+#include <PN5180ISO15693.h>
+
+#if defined(ARDUINO_AVR_UNO) || defined(ARDUINO_AVR_MEGA2560) || defined(ARDUINO_AVR_NANO)
+
+#define PN5180_NSS  10
+#define PN5180_BUSY 9
+#define PN5180_RST  7
+#define MAX_TAGS    32   // RAM!
+
+#elif defined(ARDUINO_ARCH_ESP32)
+
+#define PN5180_NSS  16
+#define PN5180_BUSY 5
+#define PN5180_RST  17
+#define MAX_TAGS    200
+
+#else
+#error Please define your pinout here!
+#endif
+
+#define NUM_INVENTORIES 20
+// 1 = inventoryAdaptive(), 0 = inventory() with 16 slots per round
+#define ADAPTIVE 1
+
+PN5180ISO15693 nfc(PN5180_NSS, PN5180_BUSY, PN5180_RST);
+ISO15693InventoryResult results[MAX_TAGS];
+
+void setup() {
+  Serial.begin(115200);
+  Serial.println(F("=================================="));
+  Serial.println(F("Uploaded: " __DATE__ " " __TIME__));
+  Serial.println(F("PN5180 ISO15693 Inventory Benchmark"));
+
+  nfc.begin();
+  nfc.reset();
+  nfc.setupRF();
+  Serial.println(F("labels, inventories, avg. rounds to last label, avg. time [ms], labels/s"));
+}
+
+void loop() {
+  uint8_t population = 0;
+  uint32_t totalRounds = 0;
+  uint32_t totalTime = 0;
+  uint32_t totalTags = 0;
+  uint8_t runs = 0;
+
+  for (int i=0; i<NUM_INVENTORIES; i++) {
+    uint8_t numTags = 0;
+    unsigned long start = micros();
+#if ADAPTIVE
+    ISO15693ErrorCode rc = nfc.inventoryAdaptive(results, MAX_TAGS, &numTags);
+#else
+    ISO15693ErrorCode rc = nfc.inventory(results, MAX_TAGS, &numTags);
+#endif
+    unsigned long elapsed = micros() - start;
+    if (ISO15693_EC_OK != rc) {
+      Serial.print(F("Error in inventory: "));
+      Serial.println(nfc.strerror(rc));
+      nfc.reset();
+      nfc.setupRF();
+      return;
+    }
+    if (numTags > population) population = numTags;
+
+    uint8_t rounds = 0;
+    for (int j=0; j<numTags; j++) {
+      if (results[j].round >= rounds) rounds = results[j].round + 1;
+    }
+    totalRounds += rounds;
+    totalTime += elapsed;
+    totalTags += numTags;
+    runs++;
+  }
+
+  Serial.print(population);
+  Serial.print(F(", "));
+  Serial.print(runs);
+  Serial.print(F(", "));
+  Serial.print(float(totalRounds) / runs, 1);
+  Serial.print(F(", "));
+  Serial.print(float(totalTime) / runs / 1000.0, 1);
+  Serial.print(F(", "));
+  if (totalTime > 0) Serial.println(float(totalTags) * 1000000.0 / totalTime, 1);
+  else Serial.println(0);
+#if ADAPTIVE
+  ISO15693InventoryEstimator *est = nfc.getInventoryEstimator();
+  Serial.print(F("  estimate="));
+  Serial.print(est->population, 1);
+  Serial.print(F(", last: rounds="));
+  Serial.print(est->rounds);
+  Serial.print(F(" (1 slot="));
+  Serial.print(est->oneSlotRounds);
+  Serial.print(F("), empty="));
+  Serial.print(est->emptySlots);
+  Serial.print(F(", single="));
+  Serial.print(est->singleSlots);
+  Serial.print(F(", collision="));
+  Serial.println(est->collisionSlots);
+#endif
+  delay(1000);
+}
@@ -0,0 +1,90 @@
+// NAME: PN5180-NDEF.ino
+//
+// DESC: Reads the first URI record of an NFC Forum Type 5 (ISO15693) tag.
+//       The tag is read only upto the end of the URI record; the number of
+//       bytes read is printed along with the URI.
+//
+// This file is part of the PN5180 library for the Arduino environment.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// BEWARE: SPI with an Arduino to a PN5180 module has to be at a level of 3.3V
+// use of logic-level converters from 5V->3.3V is absolutely necessary
+// on most Arduinos for all input pins of PN5180!
+// If used with an ESP-32, there is no need for a logic-level converter, since
+// it operates on 3.3V already.
+//
+
+#include <PN5180.h>
+#include <PN5180ISO15693.h>
+#include <PN5180NDEF.h>
+
+#if defined(ARDUINO_AVR_UNO) || defined(ARDUINO_AVR_MEGA2560) || defined(ARDUINO_AVR_NANO)
+
+#define PN5180_NSS  10
+#define PN5180_BUSY 9
+#define PN5180_RST  7
+
+#elif defined(ARDUINO_ARCH_ESP32)
+
+#define PN5180_NSS  16
+#define PN5180_BUSY 5
+#define PN5180_RST  17
+
+#else
+#error Please define your pinout here!
+#endif
+
+PN5180ISO15693 nfc(PN5180_NSS, PN5180_BUSY, PN5180_RST);
+
+// URI identifier codes 0x00..0x04, see NFC Forum URI RTD
+const char *uriPrefix[] = { "", "http://www.", "https://www.", "http://", "https://" };
+
+void setup() {
+  Serial.begin(115200);
+  Serial.println(F("=================================="));
+  Serial.println(F("Uploaded: " __DATE__ " " __TIME__));
+  Serial.println(F("PN5180 NDEF URI reader"));
+
+  nfc.begin();
+  nfc.reset();
+  nfc.setupRF();
+}
+
+void loop() {
+  uint8_t uid[8];
+  if (ISO15693_EC_OK != nfc.getInventory(uid)) {
+    delay(500);
+    return;
+  }
+
+  PN5180NDEF ndef(nfc, uid);
+  uint8_t message[256];
+  NDEFRecord record;
+  const uint8_t uriType[] = { 'U' };
+  int16_t len = ndef.findRecord(message, sizeof(message), NDEF_TNF_WELL_KNOWN, uriType, sizeof(uriType), &record);
+  if (len < 0) {
+    Serial.print(F("No URI record, error "));
+    Serial.println(len);
+  }
+  else if (record.payloadLength > 0) {
+    if (record.payload[0] < 5) Serial.print(uriPrefix[record.payload[0]]);
+    for (int i=1; i<record.payloadLength; i++) {
+      Serial.print((char)record.payload[i]);
+    }
+    Serial.print(F(" ("));
+    Serial.print(ndef.getBytesRead());
+    Serial.print(F(" of "));
+    Serial.print(ndef.getDataSize());
+    Serial.println(F(" bytes read)"));
+  }
+  delay(1000);
+}
@@ -0,0 +1,119 @@
+// NAME: PN5180-SelectedMode.ino
+//
+// DESC: Compares addressed and selected mode ISO15693 requests:
+//       reads all blocks of one label block by block, once with the UID
+//       in every request and once within a selectTag()/deselectTag()
+//       session, and prints the time per read.
+//
+// This file is part of the PN5180 library for the Arduino environment.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// BEWARE: SPI with an Arduino to a PN5180 module has to be at a level of 3.3V
+// use of logic-level converters from 5V->3.3V is absolutely necessary
+// on most Arduinos for all input pins of PN5180!
+// If used with an ESP-32, there is no need for a logic-level converter, since
+// it operates on 3.3V already.
+//
+
+#include <PN5180.h>
+#include <PN5180ISO15693.h>
+
+#if defined(ARDUINO_AVR_UNO) || defined(ARDUINO_AVR_MEGA2560) || defined(ARDUINO_AVR_NANO)
+
+#define PN5180_NSS  10
+#define PN5180_BUSY 9
+#define PN5180_RST  7
+
+#elif defined(ARDUINO_ARCH_ESP32)
+
+#define PN5180_NSS  16
+#define PN5180_BUSY 5
+#define PN5180_RST  17
+
+#else
+#error Please define your pinout here!
+#endif
+
+// request airtime at 26 kbit/s: SOF/EOF, flags, cmd, [UID], blockNo, CRC16
+#define BYTE_US 302UL
+#define AIRTIME_ADDRESSED_US ((1 + 1 + 8 + 1 + 2) * BYTE_US + 151)
+#define AIRTIME_SELECTED_US  ((1 + 1 + 1 + 2) * BYTE_US + 151)
+
+PN5180ISO15693 nfc(PN5180_NSS, PN5180_BUSY, PN5180_RST);
+
+void setup() {
+  Serial.begin(115200);
+  Serial.println(F("=================================="));
+  Serial.println(F("Uploaded: " __DATE__ " " __TIME__));
+  Serial.println(F("PN5180 ISO15693 Selected Mode Benchmark"));
+
+  nfc.begin();
+  nfc.reset();
+  nfc.setupRF();
+}
+
+// reads all blocks, returns the average time per block in us, 0 on error
+unsigned long readAllBlocks(const uint8_t *uid, uint8_t blockSize, uint8_t numBlocks) {
+  uint8_t data[32];
+  unsigned long start = micros();
+  for (int i=0; i<numBlocks; i++) {
+    ISO15693ErrorCode rc = nfc.readSingleBlock(uid, i, data, blockSize);
+    if (ISO15693_EC_OK != rc) {
+      Serial.print(F("Error in readSingleBlock #"));
+      Serial.print(i);
+      Serial.print(F(": "));
+      Serial.println(nfc.strerror(rc));
+      return 0;
+    }
+  }
+  return (micros() - start) / numBlocks;
+}
+
+void loop() {
+  uint8_t uid[8];
+  ISO15693ErrorCode rc = nfc.getInventory(uid);
+  if (ISO15693_EC_OK != rc) {
+    Serial.println(F("No label"));
+    delay(1000);
+    return;
+  }
+
+  ISO15693SystemInfo info;
+  rc = nfc.getSystemInfo(uid, &info);
+  if ((ISO15693_EC_OK != rc) || (0 == info.numBlocks) || (info.numBlocks > 256)) {
+    Serial.println(F("Memory size unknown"));
+    delay(1000);
+    return;
+  }
+  uint8_t numBlocks = (info.numBlocks > 255) ? 255 : info.numBlocks;
+
+  unsigned long addressedUs = readAllBlocks(uid, info.blockSize, numBlocks);
+
+  unsigned long selectedUs = 0;
+  if (ISO15693_EC_OK == nfc.selectTag(uid)) {
+    selectedUs = readAllBlocks(uid, info.blockSize, numBlocks);
+    nfc.deselectTag();
+  }
+  else Serial.println(F("SELECT not supported"));
+
+  Serial.print(numBlocks);
+  Serial.print(F(" blocks, addressed: "));
+  Serial.print(addressedUs);
+  Serial.print(F(" us/read (request airtime "));
+  Serial.print(AIRTIME_ADDRESSED_US);
+  Serial.print(F(" us), selected: "));
+  Serial.print(selectedUs);
+  Serial.print(F(" us/read (request airtime "));
+  Serial.print(AIRTIME_SELECTED_US);
+  Serial.println(F(" us)"));
+  delay(1000);
+}